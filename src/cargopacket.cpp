@@ -13,12 +13,27 @@
 #include "station_base.h"
 #include "core/pool_func.hpp"
 #include "core/random_func.hpp"
+#include "core/mem_func.hpp"
 #include "economy_base.h"
+#include "vehicle_base.h"
+#include "map_func.h"
+#include "debug.h"
+#include <algorithm>
 
 /* Initialize the cargopacket-pool */
 CargoPacketPool _cargopacket_pool("CargoPacket");
 INSTANTIATE_POOL_METHODS(CargoPacket)
 
+CargoPacketPoolStats _cargopacket_pool_stats; ///< Statistics about the pressure on the cargo packet pool.
+static uint64 _cargopacket_reported_dropped;  ///< Dropped cargo already warned about.
+
+/** Reset the cargo packet pool statistics for a new game. */
+void InitializeCargoPackets()
+{
+	MemSetT(&_cargopacket_pool_stats, 0);
+	_cargopacket_reported_dropped = 0;
+}
+
 /**
  * Create a new packet for savegame loading.
  */
@@ -182,6 +197,50 @@ void CargoList<Tinst, Tcont>::AddToCache(const CargoPacket *cp)
 	this->cargo_days_in_transit += cp->days_in_transit * cp->count;
 }
 
+/**
+ * Update the cached values to reflect the removal of a run of packets.
+ * @param run Run of packets to be removed from cache.
+ */
+template <class Tinst, class Tcont>
+void CargoList<Tinst, Tcont>::RemoveFromCache(const CargoPacketRun &run)
+{
+	this->count                 -= run.count;
+	this->cargo_days_in_transit -= run.cargo_days_in_transit;
+}
+
+/**
+ * Update the cache to reflect adding a run of packets.
+ * @param run Run of packets to be inserted.
+ */
+template <class Tinst, class Tcont>
+void CargoList<Tinst, Tcont>::AddToCache(const CargoPacketRun &run)
+{
+	this->count                 += run.count;
+	this->cargo_days_in_transit += run.cargo_days_in_transit;
+}
+
+/**
+ * Move the longest run of whole packets from the front of a list into this
+ * run, which fits into the given capacity together with the packets already
+ * in the run. The caches of the list aren't updated.
+ * @param list List to take the packets from.
+ * @param cap Maximum amount of cargo in the run.
+ * @param load_place New loaded_at for the packets or INVALID_TILE if the
+ *        current one shall be kept.
+ */
+void CargoPacketRun::Take(CargoPacketList &list, uint cap, TileIndex load_place)
+{
+	CargoPacketList::iterator end(list.begin());
+	for (; end != list.end() && this->count + (*end)->count <= cap; ++end) {
+		CargoPacket *cp = *end;
+		this->count += cp->count;
+		this->cargo_days_in_transit += cp->days_in_transit * cp->count;
+		this->feeder_share += cp->feeder_share;
+		if (load_place != INVALID_TILE) cp->loaded_at_xy = load_place;
+	}
+	this->packets.splice(this->packets.end(), list, list.begin(), end);
+}
+
 /**
  * Appends the given cargo packet. Tries to merge it with another one in the
  * packets list. If no fitting packet is found, appends it.
@@ -195,6 +254,7 @@ void CargoList<Tinst, Tcont>::AddToCache(const CargoPacket *cp)
 void VehicleCargoList::Append(CargoPacket *cp, bool update_cache)
 {
 	assert(cp != NULL);
+	this->ApplyPendingAge();
 	if (update_cache) this->AddToCache(cp);
 	for (CargoPacketList::reverse_iterator it(this->packets.rbegin()); it != this->packets.rend(); it++) {
 		CargoPacket *icp = *it;
@@ -208,6 +268,33 @@ void VehicleCargoList::Append(CargoPacket *cp, bool update_cache)
 	this->packets.push_back(cp);
 }
 
+/**
+ * Appends a run of packets to the end of this list in one go. Each packet of
+ * the run is merged with the last packet in the list if possible; otherwise
+ * it becomes the last packet. Like that the remainder of a packet split by
+ * the previous move and consecutive packets of the same origin are merged.
+ * @param run Run of packets to add; it is empty afterwards.
+ */
+void VehicleCargoList::Append(CargoPacketRun &run)
+{
+	if (run.packets.empty()) return;
+	this->ApplyPendingAge();
+	this->AddToCache(run);
+
+	for (CargoPacketList::iterator it(run.packets.begin()); it != run.packets.end(); ++it) {
+		CargoPacket *cp = *it;
+		if (!this->packets.empty()) {
+			CargoPacket *icp = this->packets.back();
+			if (VehicleCargoList::AreMergable(icp, cp) && icp->count + cp->count <= CargoPacket::MAX_COUNT) {
+				icp->Merge(cp);
+				continue;
+			}
+		}
+		this->packets.push_back(cp);
+	}
+	run.packets.clear();
+}
+
 /**
  * Truncates the cargo in this list to the given amount. It leaves the
  * first count cargo entities and removes the rest.
@@ -252,6 +339,17 @@ void VehicleCargoList::Reserve(CargoPacket *cp)
 	this->reserved.push_back(cp);
 }
 
+/**
+ * Reserves a run of packets for later loading and adds it to the cache.
+ * @param run Run of packets to be reserved; it is empty afterwards.
+ */
+void VehicleCargoList::Reserve(CargoPacketRun &run)
+{
+	this->AddToCache(run);
+	this->reserved_count += run.count;
+	this->reserved.splice(this->reserved.end(), run.packets);
+}
+
 /**
  * Returns all reserved cargo to the station and removes it from the cache.
  * @param ID of next the station the cargo wants to go next.
@@ -292,6 +390,15 @@ uint VehicleCargoList::LoadReserved(uint max_move)
 			this->Append(cp_new, false);
 			this->reserved_count -= max_move;
 			max_move = 0;
+		} else {
+			/* The packet can't be split; drop the part that doesn't fit and
+			 * load the rest in the next iteration. */
+			uint dropped = cp->count - max_move;
+			_cargopacket_pool_stats.dropped_cargo += dropped;
+			this->count -= dropped;
+			this->cargo_days_in_transit -= dropped * cp->days_in_transit;
+			this->reserved_count -= dropped;
+			cp->count = max_move;
 		}
 	}
 	return orig_max - max_move;
@@ -362,6 +469,7 @@ CargoPacket *CargoList<Tinst, Tcont>::RemovePacket(Iterator &it, uint cap, TileI
 		if (packet == NULL) {
 			packet = *it;
 			uint dropped = packet->count - cap;
+			_cargopacket_pool_stats.dropped_cargo += dropped;
 			this->count -= dropped;
 			this->cargo_days_in_transit -= dropped * packet->days_in_transit;
 			packet->count = cap;
@@ -566,6 +674,7 @@ UnloadType StationCargoList::WillUnloadCargoDist(byte flags, StationID next, Sta
 void VehicleCargoList::SwapReserved()
 {
 	assert(this->packets.empty());
+	this->ApplyPendingAge();
 	this->packets.swap(this->reserved);
 	this->reserved_count = 0;
 }
@@ -599,6 +708,8 @@ uint StationCargoList::TakeFrom(VehicleCargoList *source, uint max_unload, Order
 	GoodsEntry *dest = &this->station->goods[this->cargo];
 	UnloadType action;
 
+	/* Payment and transfers need the packets' actual days in transit. */
+	source->ApplyPendingAge();
 	for (VehicleCargoList::Iterator c = source->packets.begin(); c != source->packets.end() && remaining_unload > 0;) {
 		StationID cargo_source = (*c)->source;
 		FlowStatMap::const_iterator flows_it = dest->flows.find(cargo_source);
@@ -665,6 +776,28 @@ void VehicleCargoList::AddToCache(const CargoPacket *cp)
 	this->Parent::AddToCache(cp);
 }
 
+/**
+ * Update the cached values to reflect the removal of a run of packets.
+ * Decreases count, feeder share and days_in_transit.
+ * @param run Run of packets to be removed from cache.
+ */
+void VehicleCargoList::RemoveFromCache(const CargoPacketRun &run)
+{
+	this->feeder_share -= run.feeder_share;
+	this->Parent::RemoveFromCache(run);
+}
+
+/**
+ * Update the cache to reflect adding a run of packets.
+ * Increases count, feeder share and days_in_transit.
+ * @param run Run of packets to be inserted.
+ */
+void VehicleCargoList::AddToCache(const CargoPacketRun &run)
+{
+	this->feeder_share += run.feeder_share;
+	this->Parent::AddToCache(run);
+}
+
 /**
  * Moves the given amount of cargo to another vehicle (during autoreplace).
  * @param dest         Destination to move the cargo to.
@@ -673,27 +806,76 @@ void VehicleCargoList::AddToCache(const CargoPacket *cp)
  */
 uint VehicleCargoList::MoveTo(VehicleCargoList *dest, uint cap)
 {
-	uint orig_cap = cap;
-	Iterator it = packets.begin();
-	while (it != packets.end() && cap > 0) {
-		cap -= MovePacket(dest, it, cap);
+	this->ApplyPendingAge();
+
+	/* Move the whole packets in one go and split only the one at the boundary. */
+	CargoPacketRun run;
+	run.Take(this->packets, cap);
+	this->RemoveFromCache(run);
+	uint moved = run.count;
+	dest->Append(run);
+
+	if (moved < cap && !this->packets.empty()) {
+		Iterator it(this->packets.begin());
+		moved += this->MovePacket(dest, it, cap - moved);
 	}
-	return orig_cap - cap;
+	return moved;
 }
 
 /**
- * Ages the all cargo in this list.
+ * Ages the all cargo in this list. The packets themselves are only updated
+ * when one of them might reach the maximum days in transit; until then only
+ * the pending age and the cache are increased.
  */
 void VehicleCargoList::AgeCargo()
 {
-	for (ConstIterator it(this->packets.begin()); it != this->packets.end(); it++) {
-		CargoPacket *cp = *it;
-		/* If we're at the maximum, then we can't increase no more. */
-		if (cp->days_in_transit == 0xFF) continue;
+	if (this->pending_age == this->max_pending_age) {
+		this->ApplyPendingAge();
+
+		byte max_days = 0;
+		this->aging_count = 0;
+		for (ConstIterator it(this->packets.begin()); it != this->packets.end(); it++) {
+			const CargoPacket *cp = *it;
+			/* If we're at the maximum, then we can't increase no more. */
+			if (cp->days_in_transit == 0xFF) continue;
 
-		cp->days_in_transit++;
-		this->cargo_days_in_transit += cp->count;
+			this->aging_count += cp->count;
+			max_days = max(max_days, cp->days_in_transit);
+		}
+		this->max_pending_age = 0xFF - max_days;
 	}
+
+	this->pending_age++;
+	this->cargo_days_in_transit += this->aging_count;
+}
+
+/**
+ * Update the days in transit of the packets with the age accumulated since
+ * they were last updated. This has to be done before the packets are read,
+ * added or removed.
+ */
+void VehicleCargoList::ApplyPendingAge()
+{
+	if (this->pending_age > 0) {
+		for (Iterator it(this->packets.begin()); it != this->packets.end(); it++) {
+			CargoPacket *cp = *it;
+			if (cp->days_in_transit != 0xFF) cp->days_in_transit += this->pending_age;
+		}
+		this->pending_age = 0;
+	}
+	/* The packets may change, so the next aging has to look at them again. */
+	this->max_pending_age = 0;
+}
+
+/**
+ * Truncates the cargo in this list to the given amount after applying the
+ * pending age.
+ * @param max_remaining Maximum amount of entities to be in the list after the command.
+ */
+void VehicleCargoList::Truncate(uint max_remaining)
+{
+	this->ApplyPendingAge();
+	this->Parent::Truncate(max_remaining);
 }
 
 /*
@@ -734,6 +916,7 @@ void StationCargoList::Append(StationID next, CargoPacket *cp)
 {
 	assert(cp != NULL);
 	this->AddToCache(cp);
+	this->AddToNextHopCache(next, cp->count);
 
 	StationCargoPacketMap::List &list = this->packets[next];
 	for (StationCargoPacketMap::List::reverse_iterator it(list.rbegin()); it != list.rend(); it++) {
@@ -749,21 +932,42 @@ void StationCargoList::Append(StationID next, CargoPacket *cp)
 }
 
 /**
- * Move packets from a specific range in this list to a vehicle.
+ * Move packets with a specific next hop from this list to a vehicle.
  * @param dest Cargo list the packets will be moved to.
  * @param cap Maximum amount of cargo to move.
- * @param begin Begin of the range to take packets from.
- * @param end End of the range to take packets from.
+ * @param next Next hop of the packets to be moved.
  * @param reserve If the packets should be loaded on or reserved for the vehicle.
  * @return Amount of cargo that has been moved.
  */
-uint StationCargoList::MovePackets(VehicleCargoList *dest, uint cap, Iterator begin, Iterator end, bool reserve)
+uint StationCargoList::MovePackets(VehicleCargoList *dest, uint cap, StationID next, bool reserve)
 {
-	uint orig_cap = cap;
-	while (begin != end && cap > 0) {
-		cap -= this->MovePacket(dest, begin, cap, this->station->xy, reserve);
+	if (cap == 0 || this->NextHopCount(next) == 0) return 0;
+
+	uint prev_count = this->count;
+	StationCargoPacketMap::MapIterator range(this->packets.find(next));
+
+	/* Move the whole packets in one go and split only the one at the boundary. */
+	CargoPacketRun run;
+	run.Take(range->second, cap, this->station->xy);
+	this->RemoveFromCache(run);
+	uint moved = run.count;
+	if (reserve) {
+		dest->Reserve(run);
+	} else {
+		dest->Append(run);
 	}
-	return orig_cap - cap;
+
+	if (range->second.empty()) {
+		this->packets.StationCargoPacketMap::Map::erase(range);
+	} else if (moved < cap) {
+		Iterator it(range);
+		moved += this->MovePacket(dest, it, cap - moved, this->station->xy, reserve);
+	}
+
+	/* Use the difference of the total count, as cargo may have been dropped
+	 * if a packet couldn't be split. */
+	this->RemoveFromNextHopCache(next, prev_count - this->count);
+	return moved;
 }
 
 /**
@@ -777,12 +981,8 @@ uint StationCargoList::MovePackets(VehicleCargoList *dest, uint cap, Iterator be
 uint StationCargoList::MoveTo(VehicleCargoList *dest, uint cap, StationID next, bool reserve)
 {
 	uint orig_cap = cap;
-	std::pair<Iterator, Iterator> bounds(this->packets.equal_range(next));
-	cap -= this->MovePackets(dest, cap, bounds.first, bounds.second, reserve);
-	if (next != INVALID_STATION && cap > 0) {
-		bounds = this->packets.equal_range(INVALID_STATION);
-		cap -= this->MovePackets(dest, cap, bounds.first, bounds.second, reserve);
-	}
+	cap -= this->MovePackets(dest, cap, next, reserve);
+	if (next != INVALID_STATION) cap -= this->MovePackets(dest, cap, INVALID_STATION, reserve);
 	return orig_cap - cap;
 }
 
@@ -798,24 +998,34 @@ void StationCargoList::RerouteStalePackets(StationID to)
 		it = this->packets.erase(it);
 		StationID next = this->station->goods[this->cargo].GetVia(packet->source, this->station->index);
 		assert(next != to);
+		this->RemoveFromCache(packet);
+		this->RemoveFromNextHopCache(to, packet->count);
 
-		/* legal, as insert doesn't invalidate iterators in the MultiMap, however
+		/* legal, as appending doesn't invalidate iterators in the MultiMap, however
 		 * this might insert the packet between range.first and range.second (which might be end())
-		 * This is why we check for GetKey above to avoid infinite loops
+		 * This is why we check for GetKey above to avoid infinite loops.
+		 * Appending merges the packet with others for the same hop if possible.
 		 */
-		this->packets.Insert(next, packet);
+		this->Append(next, packet);
 	}
 }
 
 /**
- * Truncate where each destination loses roughly the same percentage of its cargo.
- * This is done by randomizing the selection of packets to be removed. Also count
- * the cargo by origin station.
+ * Truncate the cargo in this list and count the cargo by origin station. With
+ * CTP_PROPORTIONAL each destination loses roughly the same percentage of its
+ * cargo. This is done by randomizing the selection of packets to be removed.
+ * The other policies remove the packets in a fixed order.
  * @param max_remaining Maximum amount of cargo to keep in the station.
  * @param cargo_per_source Container for counting the cargo by origin list.
+ * @param policy Policy for choosing the packets to be removed.
  */
-void StationCargoList::CountAndTruncate(uint max_remaining, StationCargoAmountMap &cargo_per_source)
+void StationCargoList::CountAndTruncate(uint max_remaining, StationCargoAmountMap &cargo_per_source, CargoTruncationPolicy policy)
 {
+	if (policy != CTP_PROPORTIONAL && this->count > max_remaining) {
+		this->CountAndTruncateInOrder(max_remaining, cargo_per_source, policy);
+		return;
+	}
+
 	uint prev_count = this->count;
 	uint loop = 0;
 	while (this->count > max_remaining) {
@@ -833,12 +1043,14 @@ void StationCargoList::CountAndTruncate(uint max_remaining, StationCargoAmountMa
 				packet->count -= diff;
 				this->count = max_remaining;
 				this->cargo_days_in_transit -= packet->days_in_transit * diff;
+				this->RemoveFromNextHopCache(it.GetKey(), diff);
 				if (loop > 0) {
 					return;
 				} else {
 					++it;
 				}
 			} else {
+				this->RemoveFromNextHopCache(it.GetKey(), packet->count);
 				it = this->packets.erase(it);
 				this->RemoveFromCache(packet);
 				delete packet;
@@ -848,6 +1060,89 @@ void StationCargoList::CountAndTruncate(uint max_remaining, StationCargoAmountMa
 	}
 }
 
+/**
+ * Merge packets in a list which are mergeable, but haven't been merged when
+ * they were added, e.g. because one of them was full back then. Merging
+ * doesn't change the sums of the packets, so the caches stay valid.
+ * @tparam Tinst Cargo list defining which packets are mergeable.
+ * @param list List of packets to compact.
+ * @return Number of packets freed.
+ */
+template <class Tinst>
+static uint MergePackets(CargoPacketList &list)
+{
+	/* The packet later mergeable packets are merged into, per kind of packet. */
+	typedef std::map<const CargoPacket *, CargoPacket *, bool (*)(const CargoPacket *, const CargoPacket *)> MergeTargetMap;
+	MergeTargetMap targets(&Tinst::MergeOrder);
+
+	uint merged = 0;
+	for (CargoPacketList::iterator it(list.begin()); it != list.end();) {
+		std::pair<MergeTargetMap::iterator, bool> target = targets.insert(std::make_pair(*it, *it));
+		if (!target.second) {
+			CargoPacket *cp = target.first->second;
+			if (cp->Count() + (*it)->Count() <= CargoPacket::MAX_COUNT) {
+				cp->Merge(*it);
+				it = list.erase(it);
+				merged++;
+				continue;
+			}
+			/* Keep merging into the packet with the most room left. */
+			if ((*it)->Count() < cp->Count()) target.first->second = *it;
+		}
+		++it;
+	}
+	return merged;
+}
+
+/**
+ * Merge all mergeable packets in this list. The reservation list is left
+ * alone as its packets are about to be loaded or returned.
+ * @return Number of packets freed.
+ */
+uint VehicleCargoList::Compact()
+{
+	return MergePackets<VehicleCargoList>(this->packets);
+}
+
+/**
+ * Merge all mergeable packets with the same next hop in this list.
+ * @return Number of packets freed.
+ */
+uint StationCargoList::Compact()
+{
+	uint merged = 0;
+	for (StationCargoPacketMap::MapIterator it(this->packets.begin()); it != this->packets.end(); ++it) {
+		merged += MergePackets<StationCargoList>(it->second);
+	}
+	return merged;
+}
+
+/**
+ * Monthly loop for cargo packets. Merges the packets in all cargo lists to
+ * relieve the packet pool and warns if cargo had to be dropped because the
+ * pool was full.
+ */
+void CargoPacketMonthlyLoop()
+{
+	_cargopacket_pool_stats.peak_packets = max(_cargopacket_pool_stats.peak_packets, _cargopacket_pool.items);
+
+	uint merged = 0;
+	Vehicle *v;
+	FOR_ALL_VEHICLES(v) merged += v->cargo.Compact();
+
+	Station *st;
+	FOR_ALL_STATIONS(st) {
+		for (CargoID c = 0; c < NUM_CARGO; c++) merged += st->goods[c].cargo.Compact();
+	}
+	_cargopacket_pool_stats.merged_packets += merged;
+
+	if (_cargopacket_pool_stats.dropped_cargo > _cargopacket_reported_dropped) {
+		DEBUG(misc, 0, "The cargo packet pool is full: " OTTD_PRINTF64 " units of cargo were dropped in the last month, %u packets merged",
+				_cargopacket_pool_stats.dropped_cargo - _cargopacket_reported_dropped, merged);
+		_cargopacket_reported_dropped = _cargopacket_pool_stats.dropped_cargo;
+	}
+}
+
 /**
  * Invalidates the cached data and rebuilds it.
  */
@@ -860,6 +1155,144 @@ void VehicleCargoList::InvalidateCache()
 		this->AddToCache(*it);
 		this->reserved_count += (*it)->count;
 	}
+	/* Add the age that hasn't been applied to the packets yet. */
+	for (ConstIterator it(this->packets.begin()); it != this->packets.end(); it++) {
+		if ((*it)->days_in_transit != 0xFF) this->cargo_days_in_transit += this->pending_age * (*it)->count;
+	}
+}
+
+/** Packet to be removed by CountAndTruncateInOrder, ordered by the truncation policy. */
+struct TruncationCandidate {
+	uint priority;                                ///< Priority of removing the packet; higher ones are removed first.
+	uint index;                                   ///< Position of the packet in the list, to break ties deterministically.
+	StationCargoPacketMap::MapIterator map_it;    ///< Range of the packet's next hop.
+	StationCargoPacketMap::ListIterator list_it;  ///< Packet in the range.
+
+	/**
+	 * Compare two candidates. The heap pops the greatest one, i.e. the one
+	 * with the highest priority that comes first in the list.
+	 * @param other Candidate to compare with.
+	 * @return If this candidate is to be removed after the other one.
+	 */
+	inline bool operator<(const TruncationCandidate &other) const
+	{
+		return this->priority < other.priority || (this->priority == other.priority && this->index > other.index);
+	}
+};
+
+/**
+ * Truncate by removing the packets in the order given by a policy and count
+ * the cargo by origin station. The packets are put into a heap in one pass,
+ * so that choosing each packet to be removed costs O(log n).
+ * @param max_remaining Maximum amount of cargo to keep in the station.
+ * @param cargo_per_source Container for counting the cargo by origin list.
+ * @param policy Policy for choosing the packets to be removed.
+ * @pre this->count > max_remaining
+ */
+void StationCargoList::CountAndTruncateInOrder(uint max_remaining, StationCargoAmountMap &cargo_per_source, CargoTruncationPolicy policy)
+{
+	std::vector<TruncationCandidate> heap;
+	for (StationCargoPacketMap::MapIterator map_it(this->packets.begin()); map_it != this->packets.end(); ++map_it) {
+		for (StationCargoPacketMap::ListIterator list_it(map_it->second.begin()); list_it != map_it->second.end(); ++list_it) {
+			const CargoPacket *cp = *list_it;
+			cargo_per_source[cp->source] += cp->count;
+
+			TruncationCandidate candidate;
+			switch (policy) {
+				case CTP_OLDEST:   candidate.priority = cp->days_in_transit; break;
+				case CTP_FARTHEST: candidate.priority = DistanceManhattan(cp->source_xy, this->station->xy); break;
+				default: NOT_REACHED();
+			}
+			candidate.index = (uint)heap.size();
+			candidate.map_it = map_it;
+			candidate.list_it = list_it;
+			heap.push_back(candidate);
+		}
+	}
+	std::make_heap(heap.begin(), heap.end());
+
+	while (this->count > max_remaining) {
+		assert(!heap.empty());
+		std::pop_heap(heap.begin(), heap.end());
+		const TruncationCandidate &victim = heap.back();
+		CargoPacket *packet = *victim.list_it;
+
+		uint diff = this->count - max_remaining;
+		if (packet->count > diff) {
+			packet->count -= diff;
+			this->count = max_remaining;
+			this->cargo_days_in_transit -= packet->days_in_transit * diff;
+			this->RemoveFromNextHopCache(victim.map_it->first, diff);
+			return;
+		}
+
+		this->RemoveFromNextHopCache(victim.map_it->first, packet->count);
+		this->RemoveFromCache(packet);
+		victim.map_it->second.erase(victim.list_it);
+		if (victim.map_it->second.empty()) this->packets.StationCargoPacketMap::Map::erase(victim.map_it);
+		delete packet;
+		heap.pop_back();
+	}
+}
+
+/**
+ * Update the cache for a next hop to reflect adding cargo for it.
+ * @param next Next hop of the cargo.
+ * @param count Amount of cargo added.
+ */
+void StationCargoList::AddToNextHopCache(StationID next, uint count)
+{
+	if (count > 0) this->count_per_next[next] += count;
+}
+
+/**
+ * Update the cache for a next hop to reflect removing cargo for it. The
+ * hop's entry is dropped when its last cargo has been removed.
+ * @param next Next hop of the cargo.
+ * @param count Amount of cargo removed.
+ */
+void StationCargoList::RemoveFromNextHopCache(StationID next, uint count)
+{
+	if (count == 0) return;
+	StationCargoAmountMap::iterator it(this->count_per_next.find(next));
+	assert(it != this->count_per_next.end() && it->second >= count);
+	it->second -= count;
+	if (it->second == 0) this->count_per_next.erase(it);
+}
+
+/**
+ * Truncates the cargo in this list to the given amount and rebuilds the
+ * cached counts per next hop.
+ * @param max_remaining Maximum amount of entities to be in the list after the command.
+ */
+void StationCargoList::Truncate(uint max_remaining)
+{
+	this->Parent::Truncate(max_remaining);
+	this->InvalidateCache();
+}
+
+/**
+ * Invalidates the cached data and rebuilds it. The counts per next hop are
+ * updated in place, so that rebuilding a valid cache leaves it bytewise
+ * unchanged; CheckCaches relies on that.
+ */
+void StationCargoList::InvalidateCache()
+{
+	this->Parent::InvalidateCache();
+
+	for (StationCargoAmountMap::iterator it(this->count_per_next.begin()); it != this->count_per_next.end(); ++it) {
+		it->second = 0;
+	}
+	for (ConstIterator it(this->packets.begin()); it != this->packets.end(); ++it) {
+		this->count_per_next[it.GetKey()] += (*it)->count;
+	}
+	for (StationCargoAmountMap::iterator it(this->count_per_next.begin()); it != this->count_per_next.end();) {
+		if (it->second == 0) {
+			this->count_per_next.erase(it++);
+		} else {
+			++it;
+		}
+	}
 }
 
 /**
@@ -31,9 +31,18 @@ typedef Pool<CargoPacket, CargoPacketID, 1024, 0xFFF000, PT_NORMAL, true, false>
 /** The actual pool with cargo packets. */
 extern CargoPacketPool _cargopacket_pool;
 
+/** Statistics about the pressure on the cargo packet pool since the game was started. */
+struct CargoPacketPoolStats {
+	uint64 dropped_cargo;  ///< Cargo entities dropped because no packet could be allocated.
+	uint64 merged_packets; ///< Packets freed by merging them into others during compaction.
+	size_t peak_packets;   ///< Highest number of packets seen at a compaction.
+};
+extern CargoPacketPoolStats _cargopacket_pool_stats;
+
 template <class Tinst, class Tcont> class CargoList;
 class StationCargoList; // forward-declare, so we can use it in VehicleCargoList::Unreserve
 class VehicleCargoList; // forward-declare, so we can use it in CargoList::MovePacket
+struct CargoPacketRun;  // forward-declare, so we can use it in CargoList::AddToCache
 extern const struct SaveLoad *GetCargoPacketDesc();
 
 /**
@@ -54,6 +63,7 @@ private:
 	template <class Tinst, class Tcont> friend class CargoList;
 	friend class VehicleCargoList;
 	friend class StationCargoList;
+	friend struct CargoPacketRun;
 	/** We want this to be saved, right? */
 	friend const struct SaveLoad *GetCargoPacketDesc();
 public:
@@ -194,8 +204,10 @@ protected:
 	Tcont packets;              ///< The cargo packets in this list.
 
 	void AddToCache(const CargoPacket *cp);
+	void AddToCache(const CargoPacketRun &run);
 
 	void RemoveFromCache(const CargoPacket *cp);
+	void RemoveFromCache(const CargoPacketRun &run);
 
 	CargoPacket *RemovePacket(Iterator &it, uint cap, TileIndex load_place = INVALID_TILE);
 
@@ -254,6 +266,23 @@ public:
 
 typedef std::list<CargoPacket *> CargoPacketList;
 
+/**
+ * Run of whole packets taken from the front of a cargo list in one go, with
+ * the sums of the values the cargo lists cache. Moving a run updates the
+ * caches once instead of once per packet.
+ */
+struct CargoPacketRun {
+	CargoPacketList packets;    ///< The packets in the run.
+	uint count;                 ///< Sum of the packets' cargo entities.
+	uint cargo_days_in_transit; ///< Sum of the days in transit of the packets' cargo entities.
+	Money feeder_share;         ///< Sum of the packets' feeder shares.
+
+	/** Create an empty run. */
+	CargoPacketRun() : count(0), cargo_days_in_transit(0), feeder_share(0) {}
+
+	void Take(CargoPacketList &list, uint cap, TileIndex load_place = INVALID_TILE);
+};
+
 /**
  * CargoList that is used for vehicles.
  */
@@ -269,9 +298,14 @@ protected:
 	CargoPacketList reserved; ///< Packets reserved for unloading in this list.
 	Money feeder_share;       ///< Cache for the feeder share.
 	uint reserved_count;      ///< Cache for the number of reserved cargo entities.
+	uint aging_count;         ///< Number of cargo entities in packets below the maximum days in transit when their age was last updated.
+	byte pending_age;         ///< Days the packets have aged since their days in transit were last updated.
+	byte max_pending_age;     ///< Days the packets can age before one of them might reach the maximum days in transit; 0 if unknown.
 
 	void AddToCache(const CargoPacket *cp);
+	void AddToCache(const CargoPacketRun &run);
 	void RemoveFromCache(const CargoPacket *cp);
+	void RemoveFromCache(const CargoPacketRun &run);
 
 public:
 	/** The station cargo list needs to control the unloading. */
@@ -295,6 +329,7 @@ public:
 	}
 
 	void Append(CargoPacket *cp, bool update_cache = true);
+	void Append(CargoPacketRun &run);
 
 	/**
 	 * Returns sum of cargo on board the vehicle (ie not only
@@ -343,6 +378,7 @@ public:
 	}
 
 	void Reserve(CargoPacket *cp);
+	void Reserve(CargoPacketRun &run);
 
 	void Unreserve(StationID next, StationCargoList *dest);
 
@@ -352,10 +388,16 @@ public:
 
 	void AgeCargo();
 
+	void ApplyPendingAge();
+
+	void Truncate(uint max_remaining);
+
 	void InvalidateCache();
 
 	uint MoveTo(VehicleCargoList *dest, uint cap);
 
+	uint Compact();
+
 	/**
 	 * Are two the two CargoPackets mergeable in the context of
 	 * a list of CargoPackets for a Vehicle?
@@ -371,6 +413,22 @@ public:
 				cp1->source_id       == cp2->source_id &&
 				cp1->loaded_at_xy    == cp2->loaded_at_xy;
 	}
+
+	/**
+	 * Order of CargoPackets in the context of a list of CargoPackets for a
+	 * Vehicle, in which two packets are equivalent if they are mergeable.
+	 * @param cp1 First CargoPacket.
+	 * @param cp2 Second CargoPacket.
+	 * @return True if cp1 comes before cp2.
+	 */
+	static bool MergeOrder(const CargoPacket *cp1, const CargoPacket *cp2)
+	{
+		if (cp1->source_xy != cp2->source_xy) return cp1->source_xy < cp2->source_xy;
+		if (cp1->days_in_transit != cp2->days_in_transit) return cp1->days_in_transit < cp2->days_in_transit;
+		if (cp1->source_type != cp2->source_type) return cp1->source_type < cp2->source_type;
+		if (cp1->source_id != cp2->source_id) return cp1->source_id < cp2->source_id;
+		return cp1->loaded_at_xy < cp2->loaded_at_xy;
+	}
 };
 
 typedef MultiMap<StationID, CargoPacket *> StationCargoPacketMap;
@@ -403,6 +461,21 @@ public:
 				cp1->source_id       == cp2->source_id;
 	}
 
+	/**
+	 * Order of CargoPackets in the context of a list of CargoPackets for a
+	 * Station, in which two packets are equivalent if they are mergeable.
+	 * @param cp1 First CargoPacket.
+	 * @param cp2 Second CargoPacket.
+	 * @return True if cp1 comes before cp2.
+	 */
+	static bool MergeOrder(const CargoPacket *cp1, const CargoPacket *cp2)
+	{
+		if (cp1->source_xy != cp2->source_xy) return cp1->source_xy < cp2->source_xy;
+		if (cp1->days_in_transit != cp2->days_in_transit) return cp1->days_in_transit < cp2->days_in_transit;
+		if (cp1->source_type != cp2->source_type) return cp1->source_type < cp2->source_type;
+		return cp1->source_id < cp2->source_id;
+	}
+
 	uint TakeFrom(VehicleCargoList *source, uint max_unload, OrderUnloadFlags flags, StationID next_station, bool has_stopped, CargoPayment *payment);
 
 	uint MoveTo(VehicleCargoList *dest, uint cap, StationID next_station, bool reserve = false);
@@ -411,7 +484,24 @@ public:
 
 	void RerouteStalePackets(StationID to);
 
-	void CountAndTruncate(uint max_remaining, StationCargoAmountMap &cargo_per_source);
+	void CountAndTruncate(uint max_remaining, StationCargoAmountMap &cargo_per_source, CargoTruncationPolicy policy);
+
+	void Truncate(uint max_remaining);
+
+	void InvalidateCache();
+
+	uint Compact();
+
+	/**
+	 * Returns the number of cargo entities waiting for the given next hop.
+	 * @param next Next hop to count the cargo for.
+	 * @return The before mentioned number.
+	 */
+	inline uint NextHopCount(StationID next) const
+	{
+		StationCargoAmountMap::const_iterator it(this->count_per_next.find(next));
+		return it == this->count_per_next.end() ? 0 : it->second;
+	}
 
 	/**
 	 * Returns source of the first cargo packet in this list.
@@ -427,15 +517,24 @@ public:
 	static void InvalidateAllFrom(SourceType src_type, SourceID src);
 
 protected:
-	Station *station; ///< Station this cargo list belongs to.
-	CargoID cargo;    ///< Cargo type this list holds.
+	/** The (direct) parent of this class. */
+	typedef CargoList<StationCargoList, StationCargoPacketMap> Parent;
+
+	Station *station;                     ///< Station this cargo list belongs to.
+	CargoID cargo;                        ///< Cargo type this list holds.
+	StationCargoAmountMap count_per_next; ///< Cache for the number of cargo entities per next hop; hops without cargo have no entry.
+
+	void AddToNextHopCache(StationID next, uint count);
+	void RemoveFromNextHopCache(StationID next, uint count);
+
+	void CountAndTruncateInOrder(uint max_remaining, StationCargoAmountMap &cargo_per_source, CargoTruncationPolicy policy);
 
 	byte GetUnloadFlags(OrderUnloadFlags order_flags);
 
 	UnloadType WillUnloadOld(byte flags, StationID source);
 	UnloadType WillUnloadCargoDist(byte flags, StationID next_station, StationID via, StationID source);
 
-	uint MovePackets(VehicleCargoList *dest, uint cap, Iterator begin, Iterator end, bool reserve);
+	uint MovePackets(VehicleCargoList *dest, uint cap, StationID next, bool reserve);
 };
 
 #endif /* CARGOPACKET_H */
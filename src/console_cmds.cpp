@@ -38,6 +38,11 @@
 #include "console_func.h"
 #include "engine_base.h"
 #include "game/game.hpp"
+#include "station_base.h"
+#include "cargotype.h"
+#include "linkgraph/benchmark.h"
+#include "pathfinder/yapf/yapf_cache.h"
+#include "pathfinder/pf_stats.h"
 
 #ifdef ENABLE_NETWORK
 	#include "table/strings.h"
@@ -1862,6 +1867,213 @@ DEF_CONSOLE_CMD(ConNewGRFReload)
 	return true;
 }
 
+/**
+ * Compare the time the MCF Dijkstra search takes with the indexed heap and
+ * with a std::set on a generated geometric component and print the results.
+ * @param size Number of nodes.
+ * @param seed Seed of the generator.
+ */
+static void LinkGraphHeapBenchmark(uint size, uint32 seed)
+{
+	LinkGraphBenchmark component(0);
+	component.Generate(LBG_GEOMETRIC, size, seed);
+	LinkGraphHeapBenchmarkResult result;
+	component.CompareHeaps(result);
+
+	IConsolePrintF(CC_DEFAULT, "Nodes: %u, edges: %u, searches per annotation: %u", result.nodes, result.edges, result.searches);
+	static const char * const annotation_names[LBA_NUM] = { "distance", "capacity" };
+	for (uint annotation = 0; annotation < LBA_NUM; ++annotation) {
+		IConsolePrintF(CC_DEFAULT, "  %-8s indexed heap: " OTTD_PRINTF64 " kcycles, std::set: " OTTD_PRINTF64 " kcycles", annotation_names[annotation],
+				result.heap_cycles[annotation] / 1000, result.set_cycles[annotation] / 1000);
+	}
+	if (!result.same_paths) IConsolePrintF(CC_ERROR, "The indexed heap and std::set found different paths.");
+}
+
+DEF_CONSOLE_CMD(ConLinkGraphBenchmark)
+{
+	if (argc < 3 || argc > 5) {
+		IConsoleHelp("Run the link graph calculation on synthetic or in-game components in the current thread and time it. Usage: 'linkgraph_bench grid|hub|geometric <nodes> [<cargo> [<seed>]]', 'linkgraph_bench game <cargo>' or 'linkgraph_bench heap <nodes> [<seed>]'");
+		IConsoleHelp("'grid', 'hub' and 'geometric' generate a component with the given number of nodes. 'game' runs all components of the given cargo's link graph in the current game");
+		IConsoleHelp("'heap' times the Dijkstra search of the flow calculation with its indexed heap and with a std::set on a geometric component");
+		IConsolePrintF(CC_WARNING, "- Components with more than %u nodes or %u edges are skipped. The benchmark isn't available in multiplayer as it stops the game while it runs", LINKGRAPH_BENCHMARK_MAX_NODES, LINKGRAPH_BENCHMARK_MAX_EDGES);
+		return true;
+	}
+
+	uint32 cargo = 0;
+	uint32 size = 0;
+	uint32 seed = 1;
+	bool game = strcmp(argv[1], "game") == 0;
+	bool heap = strcmp(argv[1], "heap") == 0;
+	LinkGraphBenchmarkShape shape = LBG_GRID;
+	if (game) {
+		if (argc != 3 || !GetArgumentInteger(&cargo, argv[2])) return false;
+	} else if (heap) {
+		if (argc > 4 || !GetArgumentInteger(&size, argv[2]) || size < 2) return false;
+		if (argc > 3 && !GetArgumentInteger(&seed, argv[3])) return false;
+	} else {
+		if (strcmp(argv[1], "hub") == 0) {
+			shape = LBG_HUB;
+		} else if (strcmp(argv[1], "geometric") == 0) {
+			shape = LBG_GEOMETRIC;
+		} else if (strcmp(argv[1], "grid") != 0) {
+			return false;
+		}
+		if (!GetArgumentInteger(&size, argv[2]) || size < 2) return false;
+		if (argc > 3 && !GetArgumentInteger(&cargo, argv[3])) return false;
+		if (argc > 4 && !GetArgumentInteger(&seed, argv[4])) return false;
+	}
+
+	if (size > LINKGRAPH_BENCHMARK_MAX_NODES) {
+		IConsolePrintF(CC_ERROR, "Components can have at most %u nodes.", LINKGRAPH_BENCHMARK_MAX_NODES);
+		return true;
+	}
+	if (heap) {
+		LinkGraphHeapBenchmark(size, seed);
+		return true;
+	}
+
+	if (cargo >= NUM_CARGO || !CargoSpec::Get(cargo)->IsValid()) {
+		IConsolePrintF(CC_ERROR, "Cargo %u doesn't exist.", cargo);
+		return true;
+	}
+	if (_settings_game.linkgraph.GetDistributionType(cargo) == DT_MANUAL) {
+		IConsolePrintF(CC_ERROR, "Cargo %u uses manual distribution.", cargo);
+		return true;
+	}
+
+	LinkGraphBenchmarkResult result;
+	LinkGraphBenchmark component(cargo);
+	if (game) {
+		std::set<StationID> seen;
+		Station *st;
+		FOR_ALL_STATIONS(st) {
+			if (st->goods[cargo].link_stats.empty() || seen.find(st->index) != seen.end()) continue;
+			component.CreateFromGame(st, seen);
+			component.Run(result);
+		}
+	} else {
+		component.Generate(shape, size, seed);
+		component.Run(result);
+	}
+
+	IConsolePrintF(CC_DEFAULT, "Components: %u, nodes: %u, edges: %u, clusters: %u", result.components, result.nodes, result.edges, result.clusters);
+	if (result.skipped != 0) IConsolePrintF(CC_WARNING, "Skipped %u components exceeding the size limits.", result.skipped);
+	uint64 total = 0;
+	for (uint step = 0; step < LBS_NUM_STEPS; ++step) {
+		IConsolePrintF(CC_DEFAULT, "  %-15s " OTTD_PRINTF64 " kcycles", LinkGraphBenchmark::GetStepName((LinkGraphBenchmarkStep)step), result.cycles[step] / 1000);
+		total += result.cycles[step];
+	}
+	IConsolePrintF(CC_DEFAULT, "  %-15s " OTTD_PRINTF64 " kcycles", "total", total / 1000);
+	IConsolePrintF(CC_DEFAULT, "Peak memory (estimated): %u kB", (uint)(result.peak_memory / 1024));
+	IConsolePrintF(CC_DEFAULT, "Flow checksum: %08X%08X", (uint)(result.checksum >> 32), (uint)result.checksum);
+	return true;
+}
+
+/**
+ * Print the measurements of the last jobs of a link graph.
+ * @param cargo Cargo of the link graph.
+ */
+static void PrintLinkGraphStats(CargoID cargo)
+{
+	const LinkGraph::StatsHistory &history = _link_graphs[cargo].GetStatsHistory();
+	if (history.empty()) return;
+
+	IConsolePrintF(CC_DEFAULT, "Cargo %u:", cargo);
+	for (LinkGraph::StatsHistory::const_iterator i = history.begin(); i != history.end(); ++i) {
+		YearMonthDay ymd;
+		ConvertDateToYMD(i->join_date, &ymd);
+		IConsolePrintF(CC_DEFAULT, "  %4d-%02d-%02d component %u: %u nodes, %u edges, %u kB peak, join " OTTD_PRINTF64 " kcycles%s",
+				ymd.year, ymd.month + 1, ymd.day, i->component, i->nodes, i->edges, (uint)(i->peak_memory / 1024),
+				i->join_cycles / 1000, i->join_blocked ? " (blocked)" : "");
+		for (uint handler = 0; handler < i->num_handlers; ++handler) {
+			const char *name = LinkGraphJob::GetHandlerName(handler);
+			IConsolePrintF(CC_DEFAULT, "    %-15s " OTTD_PRINTF64 " kcycles", name == NULL ? "?" : name, i->handler_cycles[handler] / 1000);
+		}
+	}
+}
+
+DEF_CONSOLE_CMD(ConLinkGraphStats)
+{
+	if (argc == 0 || argc > 2) {
+		IConsoleHelp("Show the time and memory the last link graph jobs took. Usage: 'linkgraph_stats [<cargo>]'");
+		return true;
+	}
+
+	if (argc == 2) {
+		uint32 cargo;
+		if (!GetArgumentInteger(&cargo, argv[1])) return false;
+		if (cargo >= NUM_CARGO) {
+			IConsolePrintF(CC_ERROR, "Cargo %u doesn't exist.", cargo);
+			return true;
+		}
+		PrintLinkGraphStats((CargoID)cargo);
+	} else {
+		for (CargoID cargo = 0; cargo < NUM_CARGO; ++cargo) PrintLinkGraphStats(cargo);
+	}
+	return true;
+}
+
+DEF_CONSOLE_CMD(ConCargoPacketStats)
+{
+	if (argc == 0) {
+		IConsoleHelp("Show how full the cargo packet pool is and how much cargo was lost because of that. Usage: 'cargopacket_stats'");
+		return true;
+	}
+
+	IConsolePrintF(CC_DEFAULT, "Packets:        %u of %u (%u%%)", (uint)_cargopacket_pool.items, (uint)CargoPacketPool::MAX_SIZE,
+			(uint)(_cargopacket_pool.items * 100 / CargoPacketPool::MAX_SIZE));
+	IConsolePrintF(CC_DEFAULT, "Peak packets:   %u", (uint)_cargopacket_pool_stats.peak_packets);
+	IConsolePrintF(CC_DEFAULT, "Merged packets: " OTTD_PRINTF64, _cargopacket_pool_stats.merged_packets);
+	IConsolePrintF(_cargopacket_pool_stats.dropped_cargo == 0 ? CC_DEFAULT : CC_WARNING, "Dropped cargo:  " OTTD_PRINTF64, _cargopacket_pool_stats.dropped_cargo);
+	return true;
+}
+
+DEF_CONSOLE_CMD(ConYapfCacheStats)
+{
+	if (argc == 0) {
+		IConsoleHelp("Show the size and hit rate of the rail path finder's segment cost caches per company and rail type. Usage: 'yapf_cache_stats'");
+		return true;
+	}
+
+	YapfPrintSegmentCacheStats();
+	return true;
+}
+
+DEF_CONSOLE_CMD(ConPathfinderStats)
+{
+	if (argc == 0) {
+		IConsoleHelp("Show how often and how long the path finders ran per vehicle type, and the vehicles that took the most time. Usage: 'pf_stats [<days>]'");
+		IConsoleHelp("The statistics of the last days can be written to a CSV file in the autosave directory with 'pf_stats csv <filename>', or forgotten with 'pf_stats reset'");
+		IConsoleHelp("Statistics are only collected while the setting 'pf.collect_statistics' is enabled. Times are in CPU time stamp counter ticks");
+		return true;
+	}
+
+	if (argc == 1) {
+		PrintPathfinderStats(1);
+		return true;
+	}
+
+	if (strcasecmp(argv[1], "reset") == 0) {
+		ResetPathfinderStats();
+		return true;
+	}
+
+	if (strcasecmp(argv[1], "csv") == 0) {
+		if (argc != 3) return false;
+		if (!ExportPathfinderStats(argv[2])) {
+			IConsoleError("could not write file; the filename may not contain a directory");
+			return true;
+		}
+		IConsolePrintF(CC_DEFAULT, "Path finder statistics written to: %s", argv[2]);
+		return true;
+	}
+
+	uint32 days;
+	if (!GetArgumentInteger(&days, argv[1]) || days == 0) return false;
+	PrintPathfinderStats(days);
+	return true;
+}
+
 #ifdef _DEBUG
 /******************
  *  debug commands
@@ -1916,6 +2128,11 @@ void IConsoleStdLibRegister()
 	IConsoleCmdRegister("list_settings",ConListSettings);
 	IConsoleCmdRegister("gamelog",      ConGamelogPrint);
 	IConsoleCmdRegister("rescan_newgrf", ConRescanNewGRF);
+	IConsoleCmdRegister("linkgraph_bench", ConLinkGraphBenchmark, ConHookNoNetwork);
+	IConsoleCmdRegister("linkgraph_stats", ConLinkGraphStats);
+	IConsoleCmdRegister("cargopacket_stats", ConCargoPacketStats);
+	IConsoleCmdRegister("yapf_cache_stats", ConYapfCacheStats);
+	IConsoleCmdRegister("pf_stats",         ConPathfinderStats);
 
 	IConsoleAliasRegister("dir",          "ls");
 	IConsoleAliasRegister("del",          "rm %+");
@@ -0,0 +1,102 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file flatmap_type.hpp Map stored in a sorted vector. */
+
+#ifndef FLATMAP_TYPE_HPP
+#define FLATMAP_TYPE_HPP
+
+#include <vector>
+#include <algorithm>
+
+/**
+ * STL-style map which keeps its items in a vector sorted by key. Lookups are
+ * done with binary search on contiguous memory, and iteration is in order of
+ * the keys, just like with std::map. Inserting or erasing items moves the
+ * items behind them, so this is meant for maps which are mostly read and
+ * filled in order of their keys. Iterators and pointers to items are
+ * invalidated by inserting and erasing.
+ * @tparam Tkey Key type.
+ * @tparam Tvalue Value type; has to be copyable.
+ */
+template<typename Tkey, typename Tvalue>
+class FlatMap {
+public:
+	typedef std::pair<Tkey, Tvalue> value_type;
+	typedef typename std::vector<value_type>::iterator iterator;
+	typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+	inline iterator begin() { return this->items.begin(); }
+	inline const_iterator begin() const { return this->items.begin(); }
+	inline iterator end() { return this->items.end(); }
+	inline const_iterator end() const { return this->items.end(); }
+
+	inline bool empty() const { return this->items.empty(); }
+	inline size_t size() const { return this->items.size(); }
+	inline void clear() { this->items.clear(); }
+
+	/**
+	 * Find the item with the given key.
+	 * @param key Key to look for.
+	 * @return Iterator pointing to the item or end() if there is none.
+	 */
+	iterator find(const Tkey &key)
+	{
+		iterator it = std::lower_bound(this->items.begin(), this->items.end(), key, &FlatMap::KeyLess);
+		return (it != this->items.end() && it->first == key) ? it : this->items.end();
+	}
+
+	/**
+	 * Find the item with the given key.
+	 * @param key Key to look for.
+	 * @return Iterator pointing to the item or end() if there is none.
+	 */
+	const_iterator find(const Tkey &key) const
+	{
+		const_iterator it = std::lower_bound(this->items.begin(), this->items.end(), key, &FlatMap::KeyLess);
+		return (it != this->items.end() && it->first == key) ? it : this->items.end();
+	}
+
+	/**
+	 * Insert an item unless there already is one with the same key. Appending
+	 * at the end is cheap, inserting somewhere else moves all items behind.
+	 * @param item Item to be inserted.
+	 * @return Iterator pointing to the item with the key and whether the item was inserted.
+	 */
+	std::pair<iterator, bool> insert(const value_type &item)
+	{
+		if (this->items.empty() || this->items.back().first < item.first) {
+			this->items.push_back(item);
+			return std::make_pair(this->items.end() - 1, true);
+		}
+		iterator it = std::lower_bound(this->items.begin(), this->items.end(), item.first, &FlatMap::KeyLess);
+		if (it->first == item.first) return std::make_pair(it, false);
+		return std::make_pair(this->items.insert(it, item), true);
+	}
+
+	/**
+	 * Erase an item.
+	 * @param it Iterator pointing to the item.
+	 * @return Iterator pointing to the item behind the erased one.
+	 */
+	inline iterator erase(iterator it) { return this->items.erase(it); }
+
+private:
+	std::vector<value_type> items; ///< Items sorted by key.
+
+	/**
+	 * Compare the key of an item with another key.
+	 * @param item Item to be compared.
+	 * @param key Key to be compared.
+	 * @return If the item's key is lower than key.
+	 */
+	static inline bool KeyLess(const value_type &item, const Tkey &key) { return item.first < key; }
+};
+
+#endif /* FLATMAP_TYPE_HPP */
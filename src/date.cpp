@@ -165,6 +165,7 @@ extern void EnginesMonthlyLoop();
 extern void TownsMonthlyLoop();
 extern void IndustryMonthlyLoop();
 extern void StationMonthlyLoop();
+extern void CargoPacketMonthlyLoop();
 extern void SubsidyMonthlyLoop();
 
 extern void CompaniesYearlyLoop();
@@ -238,6 +239,7 @@ static void OnNewMonth()
 	IndustryMonthlyLoop();
 	SubsidyMonthlyLoop();
 	StationMonthlyLoop();
+	CargoPacketMonthlyLoop();
 #ifdef ENABLE_NETWORK
 	if (_network_server) NetworkServerMonthlyLoop();
 #endif /* ENABLE_NETWORK */
@@ -49,6 +49,7 @@
 #include "cargo_type.h"
 #include "water.h"
 #include "game/game.hpp"
+#include "pathfinder/yapf/yapf_cache.h"
 
 #include "table/strings.h"
 #include "table/pricebase.h"
@@ -455,6 +456,12 @@ void ChangeOwnershipOfCompanyItems(Owner old_owner, Owner new_owner)
 			ChangeTileOwner(tile, old_owner, new_owner);
 		} while (++tile != MapSize());
 
+		/* Road vehicles may only enter depots of their owner. */
+		YapfNotifyRoadCostChange(INVALID_TILE);
+		/* Trains may only use track of their owner, so segments ending at the old ownership boundary are stale. */
+		YapfNotifyTrackLayoutChange(INVALID_TILE, INVALID_TRACK);
+		YapfNotifyCompanyRemoved(old_owner);
+
 		if (new_owner != INVALID_OWNER) {
 			/* Update all signals because there can be new segment that was owned by two companies
 			 * and signals were not propagated
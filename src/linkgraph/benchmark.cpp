@@ -0,0 +1,511 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file benchmark.cpp Definition of the link graph benchmark. */
+
+#include "../stdafx.h"
+#include "../map_func.h"
+#include "../debug.h"
+#include "../core/math_func.hpp"
+#include "benchmark.h"
+#include "demands.h"
+#include "mcf.h"
+#include "flowmapper.h"
+#include "clusters.h"
+#include <queue>
+#include <set>
+
+/** Names of the benchmark steps, for printing. */
+static const char * const _step_names[LBS_NUM_STEPS] = {
+	"demands",
+	"mcf 1st pass",
+	"flows 1st pass",
+	"mcf 2nd pass",
+	"flows 2nd pass",
+	"routes",
+};
+
+/**
+ * Create an empty result.
+ */
+LinkGraphBenchmarkResult::LinkGraphBenchmarkResult() :
+		components(0), skipped(0), nodes(0), edges(0), clusters(0), peak_memory(0), checksum(14695981039346656037ULL)
+{
+	for (uint i = 0; i < LBS_NUM_STEPS; ++i) this->cycles[i] = 0;
+}
+
+/**
+ * Create an empty heap comparison result.
+ */
+LinkGraphHeapBenchmarkResult::LinkGraphHeapBenchmarkResult() :
+		nodes(0), edges(0), searches(0), same_paths(true)
+{
+	for (uint i = 0; i < LBA_NUM; ++i) {
+		this->heap_cycles[i] = 0;
+		this->set_cycles[i] = 0;
+	}
+}
+
+/**
+ * Create an empty benchmark component for the given cargo. It uses the
+ * current link graph settings.
+ * @param cargo Cargo to use the distribution type of.
+ */
+LinkGraphBenchmark::LinkGraphBenchmark(CargoID cargo)
+{
+	this->LinkGraphComponent::cargo = cargo;
+	this->Init(0);
+}
+
+/**
+ * Get the name of a benchmark step.
+ * @param step Step.
+ * @return Name of the step.
+ */
+/* static */ const char *LinkGraphBenchmark::GetStepName(LinkGraphBenchmarkStep step)
+{
+	assert(step < LBS_NUM_STEPS);
+	return _step_names[step];
+}
+
+/**
+ * Remember a link for the generated component, with a random capacity
+ * if none is given. Links that already exist are kept.
+ * @param from Source node.
+ * @param to Destination node.
+ * @param capacity Capacity of the link or 0 for a random one.
+ */
+void LinkGraphBenchmark::AddLink(NodeID from, NodeID to, uint capacity)
+{
+	if (capacity == 0) capacity = 20 + this->random.Next(400);
+	this->links.insert(std::make_pair(std::make_pair(from, to), capacity));
+}
+
+/**
+ * Add all remembered links to the component as edges, in order of their
+ * source nodes, and finish the component.
+ */
+void LinkGraphBenchmark::AddLinks()
+{
+	for (LinkMap::iterator i = this->links.begin(); i != this->links.end(); ++i) {
+		this->AddEdge(i->first.first, i->first.second, i->second);
+	}
+	this->links.clear();
+	this->CompressEdges();
+}
+
+/**
+ * Get a random tile on the map.
+ * @return Tile.
+ */
+TileIndex LinkGraphBenchmark::GetRandomTile()
+{
+	uint x = this->random.Next(MapMaxX());
+	uint y = this->random.Next(MapMaxY());
+	return TileXY(x, y);
+}
+
+/**
+ * Generate a synthetic component. Its nodes have random supplies and most
+ * of them accept cargo. The generated component only depends on the shape,
+ * size, seed and map size.
+ * @param shape Shape of the component.
+ * @param size Number of nodes.
+ * @param seed Seed for the random supplies, capacities and locations.
+ */
+void LinkGraphBenchmark::Generate(LinkGraphBenchmarkShape shape, uint size, uint32 seed)
+{
+	assert(this->GetSize() == 0 && size > 1);
+	this->random.SetSeed(seed);
+
+	switch (shape) {
+		case LBG_GRID:      this->GenerateGrid(size); break;
+		case LBG_HUB:       this->GenerateHub(size); break;
+		case LBG_GEOMETRIC: this->GenerateGeometric(size); break;
+		default: NOT_REACHED();
+	}
+
+	this->AddLinks();
+}
+
+/**
+ * Generate nodes on a square grid spread over the map, each linked to its
+ * horizontal and vertical neighbours in both directions.
+ * @param size Number of nodes.
+ */
+void LinkGraphBenchmark::GenerateGrid(uint size)
+{
+	uint side = 1;
+	while (side * side < size) side++;
+	uint spacing = max(1U, min(MapMaxX(), MapMaxY()) / side);
+
+	for (NodeID node = 0; node < size; ++node) {
+		uint x = node % side;
+		uint y = node / side;
+		this->AddNode(node, 1 + this->random.Next(500), 1, TileXY(min(x * spacing, MapMaxX()), min(y * spacing, MapMaxY())));
+		if (x > 0) {
+			this->AddLink(node, node - 1, 0);
+			this->AddLink(node - 1, node, 0);
+		}
+		if (y > 0) {
+			this->AddLink(node, node - side, 0);
+			this->AddLink(node - side, node, 0);
+		}
+	}
+}
+
+/**
+ * Generate a hub and spoke network: Every 16th node is a hub with a large
+ * supply. The hubs are linked in a ring with high capacity links. The other
+ * nodes are spokes which are only linked to their hub.
+ * @param size Number of nodes.
+ */
+void LinkGraphBenchmark::GenerateHub(uint size)
+{
+	static const uint SPOKES_PER_HUB = 15;
+	uint num_hubs = max(1U, size / (SPOKES_PER_HUB + 1));
+
+	for (NodeID node = 0; node < size; ++node) {
+		if (node < num_hubs) {
+			this->AddNode(node, 500 + this->random.Next(2000), 1, this->GetRandomTile());
+			if (node > 0) {
+				uint capacity = 1000 + this->random.Next(4000);
+				this->AddLink(node, node - 1, capacity);
+				this->AddLink(node - 1, node, capacity);
+			}
+		} else {
+			this->AddNode(node, 1 + this->random.Next(200), this->random.Next(4) != 0 ? 1 : 0, this->GetRandomTile());
+			NodeID hub = node % num_hubs;
+			this->AddLink(node, hub, 0);
+			this->AddLink(hub, node, 0);
+		}
+	}
+	if (num_hubs > 2) {
+		uint capacity = 1000 + this->random.Next(4000);
+		this->AddLink(0, num_hubs - 1, capacity);
+		this->AddLink(num_hubs - 1, 0, capacity);
+	}
+}
+
+/**
+ * Generate nodes at random locations. Each node is linked to the closest of
+ * the nodes generated before it, so that the component is connected, and to
+ * all nodes within a radius which gives about 6 links per node on average.
+ * @param size Number of nodes.
+ */
+void LinkGraphBenchmark::GenerateGeometric(uint size)
+{
+	/* Area per node is MapSize() / size; a diamond of radius r covers 2 * r * r. */
+	uint radius = max(2U, IntSqrt(3 * MapSize() / size));
+
+	for (NodeID node = 0; node < size; ++node) {
+		TileIndex xy = this->GetRandomTile();
+		this->AddNode(node, 1 + this->random.Next(500), this->random.Next(8) != 0 ? 1 : 0, xy);
+
+		NodeID closest = INVALID_NODE;
+		uint closest_distance = UINT_MAX;
+		for (NodeID other = 0; other < node; ++other) {
+			uint distance = DistanceManhattan(xy, this->GetNode(other).xy);
+			if (distance < closest_distance) {
+				closest = other;
+				closest_distance = distance;
+			}
+			if (distance <= radius) {
+				this->AddLink(node, other, 0);
+				this->AddLink(other, node, 0);
+			}
+		}
+		if (closest != INVALID_NODE) {
+			this->AddLink(node, closest, 0);
+			this->AddLink(closest, node, 0);
+		}
+	}
+}
+
+/**
+ * Build the component containing the given station from the link stats in
+ * the game, like LinkGraph::CreateComponent does, but without marking the
+ * stations.
+ * @param first Station to start the search at.
+ * @param seen Stations already used in other components; the stations of
+ *             this component are added.
+ */
+void LinkGraphBenchmark::CreateFromGame(Station *first, std::set<StationID> &seen)
+{
+	assert(this->GetSize() == 0);
+
+	std::map<Station *, NodeID> index;
+	std::queue<Station *> search_queue;
+
+	const GoodsEntry &first_good = first->goods[this->cargo];
+	index[first] = this->AddNode(first->index, first_good.supply,
+			HasBit(first_good.acceptance_pickup, GoodsEntry::GES_ACCEPTANCE), first->xy);
+	seen.insert(first->index);
+	search_queue.push(first);
+
+	while (!search_queue.empty()) {
+		Station *source = search_queue.front();
+		search_queue.pop();
+
+		const LinkStatMap &link_stats = source->goods[this->cargo].link_stats;
+		for (LinkStatMap::const_iterator i = link_stats.begin(); i != link_stats.end(); ++i) {
+			Station *target = Station::GetIfValid(i->first);
+			if (target == NULL) continue;
+
+			std::map<Station *, NodeID>::iterator index_it = index.find(target);
+			if (index_it == index.end()) {
+				const GoodsEntry &good = target->goods[this->cargo];
+				NodeID node = this->AddNode(target->index, good.supply,
+						HasBit(good.acceptance_pickup, GoodsEntry::GES_ACCEPTANCE), target->xy);
+				index_it = index.insert(std::make_pair(target, node)).first;
+				seen.insert(target->index);
+				search_queue.push(target);
+			}
+			this->AddEdge(index[source], index_it->second, i->second.Capacity());
+		}
+	}
+
+	this->CompressEdges();
+}
+
+/**
+ * Calculate a checksum of the planned flows and route distances of all nodes
+ * and the flows assigned to all edges.
+ * @return Checksum.
+ */
+uint64 LinkGraphBenchmark::GetChecksum()
+{
+	uint64 checksum = 14695981039346656037ULL;
+	for (NodeID node_id = 0; node_id < this->GetSize(); ++node_id) {
+		const Node &node = this->GetNode(node_id);
+		for (FlowMap::const_iterator i = node.flows.begin(); i != node.flows.end(); ++i) {
+			for (FlowViaMap::const_iterator j = i->second.begin(); j != i->second.end(); ++j) {
+				checksum = (checksum ^ i->first) * 1099511628211ULL;
+				checksum = (checksum ^ j->first) * 1099511628211ULL;
+				checksum = (checksum ^ (uint)j->second) * 1099511628211ULL;
+			}
+		}
+		for (RouteDistanceMap::const_iterator i = node.route_distances.begin(); i != node.route_distances.end(); ++i) {
+			checksum = (checksum ^ i->first) * 1099511628211ULL;
+			checksum = (checksum ^ i->second) * 1099511628211ULL;
+		}
+	}
+	for (EdgeVector::const_iterator i = this->edges.begin(); i != this->edges.end(); ++i) {
+		checksum = (checksum ^ i->flow) * 1099511628211ULL;
+	}
+	return checksum;
+}
+
+/**
+ * Run the handlers of a link graph job on the component in the current
+ * thread and add the time they take, the memory used and the checksum of
+ * the flows to the result. If the settings ask for it, big components are
+ * decomposed into clusters like in a link graph job; the clusters are
+ * calculated in the link graph thread pool then. Components exceeding the
+ * size limits are skipped. The component is cleared afterwards.
+ * @param result Result to add to.
+ */
+void LinkGraphBenchmark::Run(LinkGraphBenchmarkResult &result)
+{
+	if (!this->IsWithinLimits()) {
+		result.skipped++;
+		for (NodeID node = 0; node < this->GetSize(); ++node) this->GetNode(node).Init();
+		this->Clear();
+		return;
+	}
+
+	DemandHandler demands;
+	MCFHandler<MCF1stPass> mcf_1st;
+	MCFHandler<MCF2ndPass> mcf_2nd;
+	FlowMapper flows;
+	RouteMapper routes;
+	ComponentHandler *steps[LBS_NUM_STEPS] = {&demands, &mcf_1st, &flows, &mcf_2nd, &flows, &routes};
+
+	result.components++;
+	result.nodes += this->GetSize();
+	result.edges += (uint)this->edges.size();
+	result.peak_memory = max(result.peak_memory, this->GetMemoryUsage());
+
+	LinkGraphClusters clusters(this);
+	bool decomposed = clusters.GetNumClusters() > 0;
+	for (uint step = 0; step < LBS_NUM_STEPS; ++step) {
+		if (decomposed && step == LBS_MCF_1ST) {
+			clusters.Run(steps + LBS_MCF_1ST, LBS_ROUTES - LBS_MCF_1ST, result.cycles + LBS_MCF_1ST);
+			result.peak_memory = max(result.peak_memory, this->GetMemoryUsage() + clusters.GetPeakMemory());
+			result.clusters += clusters.GetNumClusters();
+			step = LBS_FLOWS_2ND;
+			continue;
+		}
+		uint64 start = ottd_rdtsc();
+		steps[step]->Run(this);
+		result.cycles[step] += ottd_rdtsc() - start;
+		result.peak_memory = max(result.peak_memory, this->GetMemoryUsage());
+	}
+
+	result.checksum = (result.checksum ^ this->GetChecksum()) * 1099511628211ULL;
+
+	for (NodeID node = 0; node < this->GetSize(); ++node) this->GetNode(node).Init();
+	this->Clear();
+}
+
+/**
+ * Get the capacity MultiCommodityFlow::Dijkstra uses for an edge when it may
+ * create new paths.
+ * @param graph Component the edge belongs to.
+ * @param edge Edge.
+ * @return Capacity reduced by the short path saturation.
+ */
+static inline uint GetSearchCapacity(LinkGraphComponent *graph, const Edge &edge)
+{
+	return max(1U, edge.capacity * graph->GetSettings().short_path_saturation / 100);
+}
+
+/**
+ * Run the Dijkstra search of MultiCommodityFlow::Dijkstra, creating new
+ * paths, with the indexed heap as priority queue.
+ * @tparam Tannotation Annotation to be used.
+ * @param graph Component to search.
+ * @param paths Fresh annotations for all nodes.
+ * @param heap Storage for the heap entries.
+ * @param positions Storage for the heap positions.
+ */
+template<class Tannotation>
+static void HeapDijkstra(LinkGraphComponent *graph, PathVector &paths, PathVector &heap, HeapPositionVector &positions)
+{
+	AnnotationHeap<Tannotation> annos(heap, positions, graph->GetSize());
+	for (NodeID node = 0; node < graph->GetSize(); ++node) annos.Append(static_cast<Tannotation *>(paths[node]));
+	annos.Heapify();
+	while (!annos.IsEmpty()) {
+		Tannotation *source = annos.Pop();
+		LinkGraphComponent::EdgeIterator end = graph->GetEdgesEnd(source->GetNode());
+		for (LinkGraphComponent::EdgeIterator i = graph->GetFirstEdge(source->GetNode()); i != end; ++i) {
+			uint capacity = GetSearchCapacity(graph, *i);
+			Tannotation *dest = static_cast<Tannotation *>(paths[i->to]);
+			if (dest->IsBetter(source, capacity, capacity - i->flow, i->distance + 1)) {
+				dest->Fork(source, capacity, capacity - i->flow, i->distance + 1);
+				annos.Update(dest);
+			}
+		}
+	}
+}
+
+/**
+ * Run the same Dijkstra search as HeapDijkstra with a std::set as priority
+ * queue, like MultiCommodityFlow::Dijkstra did before the indexed heap.
+ * @tparam Tannotation Annotation to be used.
+ * @param graph Component to search.
+ * @param paths Fresh annotations for all nodes.
+ */
+template<class Tannotation>
+static void SetDijkstra(LinkGraphComponent *graph, PathVector &paths)
+{
+	typedef std::set<Tannotation *, typename Tannotation::Comparator> AnnoSet;
+	AnnoSet annos;
+	for (NodeID node = 0; node < graph->GetSize(); ++node) annos.insert(static_cast<Tannotation *>(paths[node]));
+	while (!annos.empty()) {
+		typename AnnoSet::iterator first = annos.begin();
+		Tannotation *source = *first;
+		annos.erase(first);
+		LinkGraphComponent::EdgeIterator end = graph->GetEdgesEnd(source->GetNode());
+		for (LinkGraphComponent::EdgeIterator i = graph->GetFirstEdge(source->GetNode()); i != end; ++i) {
+			uint capacity = GetSearchCapacity(graph, *i);
+			Tannotation *dest = static_cast<Tannotation *>(paths[i->to]);
+			if (dest->IsBetter(source, capacity, capacity - i->flow, i->distance + 1)) {
+				annos.erase(dest);
+				dest->Fork(source, capacity, capacity - i->flow, i->distance + 1);
+				annos.insert(dest);
+			}
+		}
+	}
+}
+
+/**
+ * Construct fresh annotations for a search from the given node.
+ * @tparam Tannotation Annotation to be used.
+ * @param paths Memory for the annotations of all nodes.
+ * @param source Node the search starts at.
+ */
+template<class Tannotation>
+static void ResetAnnotations(PathVector &paths, NodeID source)
+{
+	for (NodeID node = 0; node < paths.size(); ++node) new (paths[node]) Tannotation(node, node == source);
+}
+
+/**
+ * Calculate a checksum of the distances and capacities of the paths found.
+ * @param paths Annotations after a search.
+ * @return Checksum.
+ */
+static uint64 GetPathsChecksum(const PathVector &paths)
+{
+	uint64 checksum = 14695981039346656037ULL;
+	for (PathVector::const_iterator i = paths.begin(); i != paths.end(); ++i) {
+		checksum = (checksum ^ (*i)->GetDistance()) * 1099511628211ULL;
+		checksum = (checksum ^ (*i)->GetCapacity()) * 1099511628211ULL;
+	}
+	return checksum;
+}
+
+/**
+ * Time Dijkstra searches from evenly spread sources with both priority queues.
+ * @tparam Tannotation Annotation to be used.
+ * @param graph Component to search.
+ * @param paths Memory for the annotations of all nodes.
+ * @param annotation Annotation the results are for.
+ * @param result Result to add to.
+ */
+template<class Tannotation>
+static void TimeDijkstra(LinkGraphComponent *graph, PathVector &paths, LinkGraphHeapBenchmarkAnnotation annotation, LinkGraphHeapBenchmarkResult &result)
+{
+	static const uint MAX_SEARCHES = 100;
+	uint stride = max(1U, graph->GetSize() / MAX_SEARCHES);
+	PathVector heap;
+	HeapPositionVector positions;
+
+	result.searches = 0;
+	for (NodeID source = 0; source < graph->GetSize() && result.searches < MAX_SEARCHES; source += stride) {
+		ResetAnnotations<Tannotation>(paths, source);
+		uint64 start = ottd_rdtsc();
+		HeapDijkstra<Tannotation>(graph, paths, heap, positions);
+		result.heap_cycles[annotation] += ottd_rdtsc() - start;
+		uint64 heap_checksum = GetPathsChecksum(paths);
+
+		ResetAnnotations<Tannotation>(paths, source);
+		start = ottd_rdtsc();
+		SetDijkstra<Tannotation>(graph, paths);
+		result.set_cycles[annotation] += ottd_rdtsc() - start;
+		if (GetPathsChecksum(paths) != heap_checksum) result.same_paths = false;
+
+		result.searches++;
+	}
+}
+
+/**
+ * Run the Dijkstra search of the MCF passes on the component with the
+ * indexed heap and with a std::set as priority queue and compare the time
+ * both take. The component is cleared afterwards.
+ * @param result Result to write to.
+ */
+void LinkGraphBenchmark::CompareHeaps(LinkGraphHeapBenchmarkResult &result)
+{
+	result.nodes = this->GetSize();
+	result.edges = (uint)this->edges.size();
+
+	/* The annotations are constructed in place, so they don't need to be allocated in the timed searches. */
+	PathVector paths;
+	for (NodeID node = 0; node < this->GetSize(); ++node) paths.push_back(new Path(node));
+
+	TimeDijkstra<DistanceAnnotation>(this, paths, LBA_DISTANCE, result);
+	TimeDijkstra<CapacityAnnotation>(this, paths, LBA_CAPACITY, result);
+
+	for (PathVector::iterator i = paths.begin(); i != paths.end(); ++i) delete *i;
+
+	for (NodeID node = 0; node < this->GetSize(); ++node) this->GetNode(node).Init();
+	this->Clear();
+}
@@ -0,0 +1,122 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file benchmark.h Declaration of the link graph benchmark. */
+
+#ifndef LINKGRAPH_BENCHMARK_H_
+#define LINKGRAPH_BENCHMARK_H_
+
+#include "linkgraph.h"
+#include "../core/random_func.hpp"
+
+static const uint LINKGRAPH_BENCHMARK_MAX_NODES = 5000;  ///< Maximum number of nodes of a component the benchmark calculates.
+static const uint LINKGRAPH_BENCHMARK_MAX_EDGES = 50000; ///< Maximum number of edges of a component the benchmark calculates.
+
+/** Shapes of synthetic components the benchmark can generate. */
+enum LinkGraphBenchmarkShape {
+	LBG_GRID,      ///< Nodes on a square grid, linked to their horizontal and vertical neighbours.
+	LBG_HUB,       ///< Hubs linked in a ring, each with a number of spokes linked only to their hub.
+	LBG_GEOMETRIC, ///< Nodes at random locations, linked to all other nodes within a radius.
+};
+
+/** Steps of the benchmark, in the order they're run. */
+enum LinkGraphBenchmarkStep {
+	LBS_DEMANDS,    ///< DemandHandler.
+	LBS_MCF_1ST,    ///< MCFHandler<MCF1stPass>.
+	LBS_FLOWS_1ST,  ///< FlowMapper after the first pass.
+	LBS_MCF_2ND,    ///< MCFHandler<MCF2ndPass>.
+	LBS_FLOWS_2ND,  ///< FlowMapper after the second pass.
+	LBS_ROUTES,     ///< RouteMapper.
+	LBS_NUM_STEPS,  ///< Number of steps.
+};
+
+/**
+ * Results of running the link graph handlers on one or more components.
+ */
+struct LinkGraphBenchmarkResult {
+	uint components;                   ///< Number of components calculated.
+	uint skipped;                      ///< Number of components skipped because they exceed the size limits.
+	uint nodes;                        ///< Sum of the components' nodes.
+	uint edges;                        ///< Sum of the components' edges.
+	uint clusters;                     ///< Sum of the clusters of the decomposed components.
+	uint64 cycles[LBS_NUM_STEPS];      ///< CPU ticks spent in each step.
+	size_t peak_memory;                ///< Highest estimated memory used by a component between two steps.
+	uint64 checksum;                   ///< Checksum of the resulting flows.
+
+	LinkGraphBenchmarkResult();
+};
+
+/** Annotations the Dijkstra searches of the heap comparison use. */
+enum LinkGraphHeapBenchmarkAnnotation {
+	LBA_DISTANCE,  ///< DistanceAnnotation, as used by the first MCF pass.
+	LBA_CAPACITY,  ///< CapacityAnnotation, as used by the second MCF pass.
+	LBA_NUM,       ///< Number of annotations.
+};
+
+/**
+ * Results of running the MCF Dijkstra search with the indexed heap and with
+ * a std::set as priority queue on the same component.
+ */
+struct LinkGraphHeapBenchmarkResult {
+	uint nodes;                        ///< Nodes of the component.
+	uint edges;                        ///< Edges of the component.
+	uint searches;                     ///< Number of searches run per annotation and queue.
+	uint64 heap_cycles[LBA_NUM];       ///< CPU ticks spent in the searches with the indexed heap.
+	uint64 set_cycles[LBA_NUM];        ///< CPU ticks spent in the searches with the std::set.
+	bool same_paths;                   ///< Whether both queues found paths of the same lengths.
+
+	LinkGraphHeapBenchmarkResult();
+};
+
+/**
+ * A component that is built without touching the game state, either from a
+ * generator or from the link stats of the stations in the game, and is then
+ * run through the same handlers as a link graph job, in the current thread.
+ */
+class LinkGraphBenchmark : public LinkGraphComponent {
+public:
+	LinkGraphBenchmark(CargoID cargo);
+
+	void Generate(LinkGraphBenchmarkShape shape, uint size, uint32 seed);
+
+	void CreateFromGame(Station *first, std::set<StationID> &seen);
+
+	void Run(LinkGraphBenchmarkResult &result);
+
+	void CompareHeaps(LinkGraphHeapBenchmarkResult &result);
+
+	static const char *GetStepName(LinkGraphBenchmarkStep step);
+
+private:
+	typedef std::map<std::pair<NodeID, NodeID>, uint> LinkMap;
+
+	Randomizer random; ///< Random numbers for the generators, independent of the game's.
+	LinkMap links;     ///< Links collected while generating, sorted by source and destination.
+
+	void AddLink(NodeID from, NodeID to, uint capacity);
+	void AddLinks();
+	TileIndex GetRandomTile();
+
+	void GenerateGrid(uint size);
+	void GenerateHub(uint size);
+	void GenerateGeometric(uint size);
+
+	uint64 GetChecksum();
+
+	/**
+	 * Check whether the component is small enough for the benchmark.
+	 * @return If neither the nodes nor the edges exceed the limits.
+	 */
+	inline bool IsWithinLimits() const
+	{
+		return this->num_nodes <= LINKGRAPH_BENCHMARK_MAX_NODES && this->edges.size() <= LINKGRAPH_BENCHMARK_MAX_EDGES;
+	}
+};
+
+#endif /* LINKGRAPH_BENCHMARK_H_ */
@@ -0,0 +1,586 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file clusters.cpp Definition of the hierarchical decomposition of big link graph components. */
+
+#include "../stdafx.h"
+#include "../debug.h"
+#include "../core/math_func.hpp"
+#include "clusters.h"
+
+/**
+ * First station ID given to the virtual nodes of the cluster components. Real
+ * stations have lower IDs.
+ */
+static const StationID VIRTUAL_STATION_BASE = (StationID)StationPool::MAX_SIZE;
+
+/* Each cluster component has at most one virtual node per cluster for the
+ * traffic leaving it and one per cluster for the traffic passing it. */
+assert_compile(StationPool::MAX_SIZE + 2 * LinkGraphClusters::MAX_CLUSTERS <= NEW_STATION);
+
+/**
+ * Split an amount into parts proportional to the given weights. The last part
+ * with a positive weight gets the rounding error.
+ * @param amount Amount to be split.
+ * @param weights Weights of the parts; overwritten with the parts.
+ */
+static void SplitProportionally(uint amount, std::vector<std::pair<NodeID, uint64> > &weights)
+{
+	uint64 total = 0;
+	for (uint i = 0; i < weights.size(); ++i) total += weights[i].second;
+	if (total == 0) return;
+
+	uint left = amount;
+	uint last = 0;
+	for (uint i = 0; i < weights.size(); ++i) {
+		if (weights[i].second == 0) continue;
+		uint part = (uint)(amount * weights[i].second / total);
+		weights[i].second = part;
+		left -= part;
+		last = i;
+	}
+	weights[last].second += left;
+}
+
+/**
+ * Add some demand between two nodes of a cluster component.
+ * @param component Cluster component.
+ * @param from Source node.
+ * @param to Destination node.
+ * @param amount Demand to be added.
+ */
+static inline void AddDemand(LinkGraphComponent &component, NodeID from, NodeID to, uint amount)
+{
+	if (amount == 0) return;
+	Demand &demand = component.GetNode(from).demands[to];
+	demand.demand += amount;
+	demand.unsatisfied_demand += amount;
+}
+
+/**
+ * Partition the component into clusters if the settings ask for it.
+ * @param component Component to be partitioned.
+ */
+LinkGraphClusters::LinkGraphClusters(LinkGraphComponent *component) :
+		component(component),
+		condensed(component->GetSettings(), component->GetCargo(), component->GetIndex()),
+		peak_memory(0)
+{
+	this->first_node.push_back(0);
+	uint size = LinkGraphClusters::GetClusterSize(component);
+	if (size != 0) this->Partition(size);
+}
+
+/**
+ * Get the number of nodes the clusters of a component should have.
+ * @param component Component to be decomposed.
+ * @return Size of the clusters or 0 if the component is small enough to be
+ *         calculated in one piece.
+ */
+/* static */ uint LinkGraphClusters::GetClusterSize(const LinkGraphComponent *component)
+{
+	uint size = component->GetSettings().cluster_size;
+	if (size == 0) return 0;
+	size = max(size, MIN_CLUSTER_SIZE);
+	return component->GetSize() > 2 * size ? size : 0;
+}
+
+/**
+ * Grow clusters of up to the given size from the lowest numbered node not in
+ * a cluster yet, in breadth-first order along the edges. Clusters with less
+ * than a quarter of that size are merged into a bigger neighbour, as far as
+ * there is one. If that doesn't leave between 2 and MAX_CLUSTERS clusters,
+ * the component isn't decomposed.
+ * @param size Maximum number of nodes in a cluster.
+ */
+void LinkGraphClusters::Partition(uint size)
+{
+	uint num_nodes = this->component->GetSize();
+	this->cluster_of.assign(num_nodes, UINT_MAX);
+
+	std::vector<uint> sizes;
+	std::vector<NodeID> queue;
+	for (NodeID seed = 0; seed < num_nodes; ++seed) {
+		if (this->cluster_of[seed] != UINT_MAX) continue;
+
+		uint cluster = (uint)sizes.size();
+		queue.clear();
+		queue.push_back(seed);
+		this->cluster_of[seed] = cluster;
+		for (uint head = 0; head < queue.size() && queue.size() < size; ++head) {
+			LinkGraphComponent::EdgeIterator end = this->component->GetEdgesEnd(queue[head]);
+			for (LinkGraphComponent::EdgeIterator i = this->component->GetFirstEdge(queue[head]); i != end && queue.size() < size; ++i) {
+				if (this->cluster_of[i->to] != UINT_MAX) continue;
+				this->cluster_of[i->to] = cluster;
+				queue.push_back(i->to);
+			}
+		}
+		sizes.push_back((uint)queue.size());
+	}
+
+	/* Merge the fragments left between bigger clusters into the first bigger
+	 * cluster they have a link to and number the clusters consecutively. */
+	std::vector<uint> merged(sizes.size(), UINT_MAX);
+	for (NodeID node = 0; node < num_nodes; ++node) {
+		uint cluster = this->cluster_of[node];
+		if (sizes[cluster] * 4 >= size || merged[cluster] != UINT_MAX) continue;
+		LinkGraphComponent::EdgeIterator end = this->component->GetEdgesEnd(node);
+		for (LinkGraphComponent::EdgeIterator i = this->component->GetFirstEdge(node); i != end; ++i) {
+			uint other = this->cluster_of[i->to];
+			if (sizes[other] * 4 >= size) {
+				merged[cluster] = other;
+				break;
+			}
+		}
+	}
+	std::vector<uint> number(sizes.size(), UINT_MAX);
+	uint num_clusters = 0;
+	for (uint cluster = 0; cluster < sizes.size(); ++cluster) {
+		if (merged[cluster] == UINT_MAX) number[cluster] = num_clusters++;
+	}
+	if (num_clusters < 2 || num_clusters > MAX_CLUSTERS) {
+		this->cluster_of.clear();
+		return;
+	}
+
+	/* Sort the nodes by cluster, keeping them in order within each cluster. */
+	this->first_node.assign(num_clusters + 1, 0);
+	for (NodeID node = 0; node < num_nodes; ++node) {
+		uint cluster = this->cluster_of[node];
+		if (merged[cluster] != UINT_MAX) cluster = merged[cluster];
+		this->cluster_of[node] = number[cluster];
+		this->first_node[number[cluster] + 1]++;
+	}
+	for (uint cluster = 0; cluster < num_clusters; ++cluster) {
+		this->first_node[cluster + 1] += this->first_node[cluster];
+	}
+	this->nodes.resize(num_nodes);
+	this->position.resize(num_nodes);
+	std::vector<uint> next(this->first_node.begin(), this->first_node.end() - 1);
+	for (NodeID node = 0; node < num_nodes; ++node) {
+		uint cluster = this->cluster_of[node];
+		this->position[node] = next[cluster] - this->first_node[cluster];
+		this->nodes[next[cluster]++] = node;
+	}
+}
+
+/**
+ * Build the condensed component and collect the links and demands between
+ * the clusters.
+ */
+void LinkGraphClusters::Condense()
+{
+	uint num_clusters = this->GetNumClusters();
+	uint num_nodes = this->component->GetSize();
+
+	for (uint cluster = 0; cluster < num_clusters; ++cluster) {
+		uint supply = 0;
+		uint demand = 0;
+		for (uint i = this->first_node[cluster]; i < this->first_node[cluster + 1]; ++i) {
+			const Node &node = this->component->GetNode(this->nodes[i]);
+			supply += node.supply;
+			demand += node.demand;
+		}
+		/* The first node of a cluster is the one it was grown from. */
+		TileIndex xy = this->component->GetNode(this->nodes[this->first_node[cluster]]).xy;
+		this->condensed.AddNode((StationID)cluster, supply, demand, xy);
+	}
+
+	std::map<std::pair<uint, uint>, uint> capacities;
+	this->entries.resize(num_clusters);
+	for (NodeID from = 0; from < num_nodes; ++from) {
+		uint from_cluster = this->cluster_of[from];
+		LinkGraphComponent::EdgeIterator end = this->component->GetEdgesEnd(from);
+		for (LinkGraphComponent::EdgeIterator i = this->component->GetFirstEdge(from); i != end; ++i) {
+			uint to_cluster = this->cluster_of[i->to];
+			if (to_cluster == from_cluster) continue;
+			capacities[std::make_pair(from_cluster, to_cluster)] += i->capacity;
+			Entry entry = {from_cluster, i->to, i->capacity};
+			this->entries[to_cluster].push_back(entry);
+		}
+	}
+	for (std::map<std::pair<uint, uint>, uint>::iterator i = capacities.begin(); i != capacities.end(); ++i) {
+		this->condensed.AddEdge(i->first.first, i->first.second, i->second);
+	}
+	this->condensed.CompressEdges();
+
+	this->outbound.assign(num_nodes, 0);
+	this->cluster_outbound.assign(num_clusters, 0);
+	this->inbound.resize(num_clusters);
+	for (NodeID from = 0; from < num_nodes; ++from) {
+		uint from_cluster = this->cluster_of[from];
+		const DemandMap &demands = this->component->GetNode(from).demands;
+		for (DemandMap::const_iterator i = demands.begin(); i != demands.end(); ++i) {
+			uint to_cluster = this->cluster_of[i->first];
+			if (to_cluster == from_cluster) continue;
+			AddDemand(this->condensed, from_cluster, to_cluster, i->second.demand);
+			this->outbound[from] += i->second.demand;
+			this->cluster_outbound[from_cluster] += i->second.demand;
+			this->inbound[to_cluster][std::make_pair(from_cluster, i->first)] += i->second.demand;
+		}
+	}
+}
+
+/**
+ * Run the handlers on a component in the current thread.
+ * @param component Component to be calculated.
+ * @param handlers Handlers to be run.
+ * @param num_handlers Number of handlers.
+ * @param cycles CPU ticks spent in each handler; the ticks are added.
+ * @param peak_memory Highest memory used by the component; updated.
+ */
+/* static */ void LinkGraphClusters::RunHandlers(LinkGraphComponent *component, ComponentHandler * const *handlers, uint num_handlers, uint64 *cycles, size_t &peak_memory)
+{
+	for (uint i = 0; i < num_handlers; ++i) {
+		uint64 start = ottd_rdtsc();
+		handlers[i]->Run(component);
+		cycles[i] += ottd_rdtsc() - start;
+		peak_memory = max(peak_memory, component->GetMemoryUsage());
+	}
+}
+
+/**
+ * Calculate the flows of the decomposed component: First on the condensed
+ * component, then on the components of all clusters in the link graph thread
+ * pool. The handlers must be able to run on any component with demands, like
+ * the MCF passes and the flow mapper.
+ * @param handlers Handlers to be run.
+ * @param num_handlers Number of handlers.
+ * @param cycles CPU ticks spent in each handler, summed over all threads; the ticks are added.
+ */
+void LinkGraphClusters::Run(ComponentHandler * const *handlers, uint num_handlers, uint64 *cycles)
+{
+	assert(this->GetNumClusters() > 1 && num_handlers <= LinkGraphJobStats::MAX_HANDLERS);
+	this->Condense();
+	LinkGraphClusters::RunHandlers(&this->condensed, handlers, num_handlers, cycles, this->peak_memory);
+
+	uint num_clusters = this->GetNumClusters();
+	ClusterTask *tasks = new ClusterTask[num_clusters];
+	ThreadPool &pool = LinkGraphJob::GetThreadPool();
+	for (uint cluster = 0; cluster < num_clusters; ++cluster) {
+		ClusterTask &task = tasks[cluster];
+		task.clusters = this;
+		task.cluster = cluster;
+		task.handlers = handlers;
+		task.num_handlers = num_handlers;
+		for (uint i = 0; i < num_handlers; ++i) task.cycles[i] = 0;
+		task.peak_memory = 0;
+		if (cluster > 0) pool.Start(&task.task, &LinkGraphClusters::RunClusterTask, &task);
+	}
+	LinkGraphClusters::RunClusterTask(&tasks[0]);
+
+	/* Assume the worst case of all clusters being calculated at the same time. */
+	for (uint cluster = 0; cluster < num_clusters; ++cluster) {
+		if (cluster > 0) pool.Wait(&tasks[cluster].task);
+		for (uint i = 0; i < num_handlers; ++i) cycles[i] += tasks[cluster].cycles[i];
+		this->peak_memory += tasks[cluster].peak_memory;
+	}
+	delete[] tasks;
+}
+
+/**
+ * Calculate one cluster.
+ * @param task ClusterTask to be run.
+ */
+/* static */ void LinkGraphClusters::RunClusterTask(void *task)
+{
+	ClusterTask *t = static_cast<ClusterTask *>(task);
+	t->clusters->CalculateCluster(t->cluster, t->handlers, t->num_handlers, t->cycles, t->peak_memory);
+}
+
+/**
+ * Build the component of a cluster, run the handlers on it and add the
+ * resulting flows to the nodes of the decomposed component. The component
+ * has the following nodes, in this order:
+ * - the nodes of the cluster,
+ * - the nodes of other clusters the cluster's nodes have links to, each with
+ *   one edge to the virtual node of its cluster,
+ * - one virtual node for each cluster the traffic can leave to, as
+ *   destination of the traffic leaving the cluster in that direction,
+ * - one virtual node for each cluster of origin of the traffic entering the
+ *   cluster, as source of that traffic, with edges to the nodes the traffic
+ *   enters the cluster at.
+ * Only the flows of the cluster's own nodes are kept. This is the only place
+ * writing to the decomposed component while the clusters are calculated, and
+ * only to the nodes and edges of the given cluster.
+ * @param cluster Cluster to be calculated.
+ * @param handlers Handlers to be run.
+ * @param num_handlers Number of handlers.
+ * @param cycles CPU ticks spent in each handler; the ticks are added.
+ * @param peak_memory Highest memory used by the cluster's component; updated.
+ */
+void LinkGraphClusters::CalculateCluster(uint cluster, ComponentHandler * const *handlers, uint num_handlers, uint64 *cycles, size_t &peak_memory)
+{
+	typedef std::map<NodeID, NodeID> LocalMap;
+	typedef std::map<uint, NodeID> ClusterNodeMap;
+	typedef std::vector<std::pair<NodeID, uint64> > WeightVector;
+
+	LinkGraphComponent sub(this->component->GetSettings(), this->component->GetCargo(), this->component->GetIndex());
+	uint begin = this->first_node[cluster];
+	uint size = this->first_node[cluster + 1] - begin;
+	const Node &condensed_node = this->condensed.GetNode(cluster);
+
+	/* Nodes of the cluster itself. */
+	for (uint i = 0; i < size; ++i) {
+		const Node &node = this->component->GetNode(this->nodes[begin + i]);
+		sub.AddNode(node.station, node.supply, node.demand, node.xy);
+	}
+
+	/* Nodes in other clusters which can be reached directly. */
+	LocalMap halo;
+	std::vector<NodeID> halo_nodes;
+	std::vector<uint> halo_capacities;
+	ClusterNodeMap exits;
+	for (uint i = 0; i < size; ++i) {
+		NodeID from = this->nodes[begin + i];
+		LinkGraphComponent::EdgeIterator end = this->component->GetEdgesEnd(from);
+		for (LinkGraphComponent::EdgeIterator e = this->component->GetFirstEdge(from); e != end; ++e) {
+			if (this->cluster_of[e->to] == cluster) continue;
+			std::pair<LocalMap::iterator, bool> inserted = halo.insert(std::make_pair(e->to, size + (NodeID)halo_nodes.size()));
+			if (inserted.second) {
+				halo_nodes.push_back(e->to);
+				halo_capacities.push_back(0);
+				exits[this->cluster_of[e->to]] = INVALID_NODE;
+			}
+			halo_capacities[inserted.first->second - size] += e->capacity;
+		}
+	}
+	for (uint i = 0; i < halo_nodes.size(); ++i) {
+		const Node &node = this->component->GetNode(halo_nodes[i]);
+		sub.AddNode(node.station, 0, 0, node.xy);
+	}
+
+	/* Virtual nodes for the traffic leaving the cluster. */
+	StationID virtual_station = VIRTUAL_STATION_BASE;
+	for (ClusterNodeMap::iterator i = exits.begin(); i != exits.end(); ++i) {
+		i->second = sub.AddNode(virtual_station++, 0, 0, this->condensed.GetNode(i->first).xy);
+	}
+
+	/* Virtual nodes for the traffic entering the cluster, by cluster of
+	 * origin. The condensed flows tell how much of it comes from which
+	 * neighbour and the links from that neighbour how it's distributed over
+	 * the nodes it enters at. */
+	std::map<uint, std::pair<uint64, uint> > entry_capacities;
+	for (EntryVector::const_iterator i = this->entries[cluster].begin(); i != this->entries[cluster].end(); ++i) {
+		std::pair<uint64, uint> &entry = entry_capacities[i->from_cluster];
+		entry.first += i->capacity;
+		entry.second++;
+	}
+	typedef std::map<uint, std::map<NodeID, uint64> > OriginEntryMap;
+	OriginEntryMap origin_entries;
+	for (std::map<uint, std::pair<uint64, uint> >::iterator n = entry_capacities.begin(); n != entry_capacities.end(); ++n) {
+		const FlowMap &flows = this->condensed.GetNode(n->first).flows;
+		for (FlowMap::const_iterator f = flows.begin(); f != flows.end(); ++f) {
+			if (f->first == cluster) continue;
+			FlowViaMap::const_iterator via = f->second.find((StationID)cluster);
+			if (via == f->second.end() || via->second <= 0) continue;
+			std::map<NodeID, uint64> &capacities = origin_entries[f->first];
+			for (EntryVector::const_iterator i = this->entries[cluster].begin(); i != this->entries[cluster].end(); ++i) {
+				if (i->from_cluster != n->first) continue;
+				/* Links without capacity don't tell how to split the flow; split it evenly then. */
+				if (n->second.first == 0) {
+					capacities[this->position[i->to]] += (uint64)via->second / n->second.second;
+				} else {
+					capacities[this->position[i->to]] += (uint64)via->second * i->capacity / n->second.first;
+				}
+			}
+		}
+	}
+	ClusterNodeMap origins;
+	std::vector<uint> origin_clusters;
+	StationID first_origin_station = virtual_station;
+	for (OriginEntryMap::iterator i = origin_entries.begin(); i != origin_entries.end(); ++i) {
+		origins[i->first] = sub.AddNode(virtual_station++, 0, 0, this->condensed.GetNode(i->first).xy);
+		origin_clusters.push_back(i->first);
+	}
+
+	/* Edges, in order of their source nodes. */
+	for (uint i = 0; i < size; ++i) {
+		NodeID from = this->nodes[begin + i];
+		LinkGraphComponent::EdgeIterator end = this->component->GetEdgesEnd(from);
+		for (LinkGraphComponent::EdgeIterator e = this->component->GetFirstEdge(from); e != end; ++e) {
+			NodeID to = (this->cluster_of[e->to] == cluster) ? this->position[e->to] : halo[e->to];
+			sub.AddEdge(i, to, e->capacity);
+		}
+	}
+	for (uint i = 0; i < halo_nodes.size(); ++i) {
+		sub.AddEdge(size + i, exits[this->cluster_of[halo_nodes[i]]], halo_capacities[i]);
+	}
+	for (OriginEntryMap::iterator i = origin_entries.begin(); i != origin_entries.end(); ++i) {
+		for (std::map<NodeID, uint64>::iterator c = i->second.begin(); c != i->second.end(); ++c) {
+			sub.AddEdge(origins[i->first], c->first, (uint)Clamp<uint64>(c->second, 1, UINT_MAX));
+		}
+	}
+	sub.CompressEdges();
+
+	/* Demands inside the cluster and of the traffic leaving it, split over
+	 * the directions like the condensed flows of the cluster's own traffic. */
+	WeightVector exit_weights;
+	FlowMap::const_iterator own_flows = condensed_node.flows.find((StationID)cluster);
+	if (own_flows != condensed_node.flows.end()) {
+		for (FlowViaMap::const_iterator via = own_flows->second.begin(); via != own_flows->second.end(); ++via) {
+			ClusterNodeMap::iterator exit = exits.find(via->first);
+			if (via->second > 0 && exit != exits.end()) exit_weights.push_back(std::make_pair(exit->second, (uint64)via->second));
+		}
+	}
+	for (uint i = 0; i < size; ++i) {
+		NodeID from = this->nodes[begin + i];
+		const DemandMap &demands = this->component->GetNode(from).demands;
+		for (DemandMap::const_iterator d = demands.begin(); d != demands.end(); ++d) {
+			if (this->cluster_of[d->first] == cluster) AddDemand(sub, i, this->position[d->first], d->second.demand);
+		}
+		if (this->outbound[from] == 0 || exit_weights.empty()) continue;
+		WeightVector parts(exit_weights);
+		SplitProportionally(this->outbound[from], parts);
+		for (WeightVector::iterator p = parts.begin(); p != parts.end(); ++p) AddDemand(sub, i, p->first, (uint)p->second);
+	}
+
+	/* Demands of the traffic entering the cluster, split into the traffic
+	 * ending here and the traffic leaving again like the condensed flows. */
+	const InboundDemandMap &inbound = this->inbound[cluster];
+	for (ClusterNodeMap::iterator o = origins.begin(); o != origins.end(); ++o) {
+		FlowMap::const_iterator flows = condensed_node.flows.find((StationID)o->first);
+		if (flows == condensed_node.flows.end()) continue;
+		for (FlowViaMap::const_iterator via = flows->second.begin(); via != flows->second.end(); ++via) {
+			if (via->second <= 0) continue;
+			if (via->first != cluster) {
+				ClusterNodeMap::iterator exit = exits.find(via->first);
+				if (exit != exits.end()) AddDemand(sub, o->second, exit->second, via->second);
+				continue;
+			}
+			WeightVector parts;
+			InboundDemandMap::const_iterator d = inbound.lower_bound(std::make_pair(o->first, (NodeID)0));
+			for (; d != inbound.end() && d->first.first == o->first; ++d) {
+				parts.push_back(std::make_pair((NodeID)this->position[d->first.second], (uint64)d->second));
+			}
+			SplitProportionally(via->second, parts);
+			for (WeightVector::iterator p = parts.begin(); p != parts.end(); ++p) AddDemand(sub, o->second, p->first, (uint)p->second);
+		}
+	}
+
+	LinkGraphClusters::RunHandlers(&sub, handlers, num_handlers, cycles, peak_memory);
+
+	/* As the clusters are calculated independently, traffic from another
+	 * cluster may enter at nodes the flows of its virtual node don't pass.
+	 * From there it follows the sum of the flows of all virtual nodes. */
+	uint num_origins = (uint)origin_clusters.size();
+	std::vector<const FlowViaMap *> incoming(num_origins * size, (const FlowViaMap *)NULL);
+	std::vector<FlowViaMap> mixed(size);
+	std::map<StationID, NodeID> local;
+	for (uint i = 0; i < size; ++i) {
+		FlowMap &flows = sub.GetNode(i).flows;
+		local[sub.GetNode(i).station] = i;
+		for (FlowMap::iterator f = flows.begin(); f != flows.end(); ++f) {
+			if (f->first < first_origin_station) continue;
+			for (FlowViaMap::iterator via = f->second.begin(); via != f->second.end(); ++via) {
+				if (via->second <= 0) continue;
+				incoming[(f->first - first_origin_station) * size + i] = &f->second;
+				mixed[i][via->first] += via->second;
+			}
+		}
+	}
+	std::vector<NodeID> queue;
+	for (uint o = 0; o < num_origins; ++o) {
+		const FlowViaMap **origin_incoming = &incoming[o * size];
+		const std::map<NodeID, uint64> &entered = origin_entries[origin_clusters[o]];
+		queue.clear();
+		for (std::map<NodeID, uint64>::const_iterator e = entered.begin(); e != entered.end(); ++e) queue.push_back(e->first);
+		for (uint head = 0; head < queue.size(); ++head) {
+			NodeID i = queue[head];
+			if (origin_incoming[i] != NULL || mixed[i].empty()) continue;
+			origin_incoming[i] = &mixed[i];
+			for (FlowViaMap::const_iterator via = mixed[i].begin(); via != mixed[i].end(); ++via) {
+				std::map<StationID, NodeID>::iterator next = local.find(via->first);
+				if (next != local.end() && origin_incoming[next->second] == NULL) queue.push_back(next->second);
+			}
+		}
+	}
+
+	/* Copy the flows and the flow over the edges of the cluster's nodes back
+	 * to the decomposed component. The flows of the traffic from other
+	 * clusters are given to the nodes of the cluster of origin. */
+	for (uint i = 0; i < size; ++i) {
+		NodeID node_id = this->nodes[begin + i];
+		Node &node = this->component->GetNode(node_id);
+		FlowMap &flows = sub.GetNode(i).flows;
+		for (FlowMap::iterator f = flows.begin(); f != flows.end() && f->first < VIRTUAL_STATION_BASE; ++f) {
+			for (FlowViaMap::iterator via = f->second.begin(); via != f->second.end(); ++via) {
+				if (via->second > 0) node.flows[f->first][via->first] += via->second;
+			}
+		}
+		for (uint o = 0; o < num_origins; ++o) {
+			if (incoming[o * size + i] != NULL) this->AddIncomingFlows(node_id, origin_clusters[o], *incoming[o * size + i]);
+		}
+
+		LinkGraphComponent::EdgeIterator end = sub.GetEdgesEnd(i);
+		for (LinkGraphComponent::EdgeIterator e = sub.GetFirstEdge(i); e != end; ++e) {
+			NodeID to = (e->to < size) ? this->nodes[begin + e->to] : halo_nodes[e->to - size];
+			this->component->GetEdge(node_id, to).flow += e->flow;
+		}
+	}
+}
+
+/**
+ * Add the flows of the traffic from another cluster at a node to the flows
+ * of all nodes of that cluster with traffic leaving it. The traffic ending at
+ * the node is split according to the demands of the nodes of origin to it, the
+ * traffic passing it according to their shares of the traffic leaving their
+ * cluster. If that would round the smallest part of a node of origin down to
+ * zero, its parts are made bigger than their share to keep the proportions
+ * between them.
+ * @param node_id Node to add the flows to.
+ * @param origin Cluster the traffic comes from.
+ * @param flows Flows of the traffic from that cluster at the node.
+ */
+void LinkGraphClusters::AddIncomingFlows(NodeID node_id, uint origin, const FlowViaMap &flows)
+{
+	/* Shares are calculated in 1/65536ths. */
+	static const uint SHARE_SHIFT = 16;
+
+	Node &node = this->component->GetNode(node_id);
+	const InboundDemandMap &inbound = this->inbound[this->cluster_of[node_id]];
+	InboundDemandMap::const_iterator inbound_demand = inbound.find(std::make_pair(origin, node_id));
+	std::vector<std::pair<StationID, uint64> > parts;
+	for (uint j = this->first_node[origin]; j < this->first_node[origin + 1]; ++j) {
+		NodeID source = this->nodes[j];
+		if (this->outbound[source] == 0) continue;
+
+		uint64 passing_share = ((uint64)this->outbound[source] << SHARE_SHIFT) / this->cluster_outbound[origin];
+		uint64 ending_share = 0;
+		if (inbound_demand != inbound.end()) {
+			const DemandMap &demands = this->component->GetNode(source).demands;
+			DemandMap::const_iterator demand = demands.find(node_id);
+			if (demand != demands.end()) ending_share = ((uint64)demand->second.demand << SHARE_SHIFT) / inbound_demand->second;
+		}
+
+		parts.clear();
+		uint64 divisor = 1ULL << SHARE_SHIFT;
+		StationID biggest = INVALID_STATION;
+		int biggest_flow = 0;
+		for (FlowViaMap::const_iterator via = flows.begin(); via != flows.end(); ++via) {
+			if (via->second <= 0) continue;
+			assert(via->first < VIRTUAL_STATION_BASE);
+			if (via->second > biggest_flow) {
+				biggest = via->first;
+				biggest_flow = via->second;
+			}
+			uint64 part = via->second * (via->first == node.station ? ending_share : passing_share);
+			if (part == 0) continue;
+			parts.push_back(std::make_pair(via->first, part));
+			divisor = min(divisor, part);
+		}
+		/* Cargo arriving here must be able to go somewhere. */
+		if (parts.empty() && biggest != INVALID_STATION) parts.push_back(std::make_pair(biggest, divisor));
+
+		FlowViaMap &source_flows = node.flows[this->component->GetNode(source).station];
+		for (uint k = 0; k < parts.size(); ++k) {
+			source_flows[parts[k].first] += (int)min<uint64>(parts[k].second / divisor, INT_MAX);
+		}
+	}
+}
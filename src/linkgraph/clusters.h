@@ -0,0 +1,106 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file clusters.h Declaration of the hierarchical decomposition of big link graph components. */
+
+#ifndef LINKGRAPH_CLUSTERS_H_
+#define LINKGRAPH_CLUSTERS_H_
+
+#include "linkgraph.h"
+#include "threadpool.h"
+
+/**
+ * Decomposition of a big component into clusters of neighbouring nodes. The
+ * flows of a decomposed component are calculated in two levels:
+ * 1. The clusters are condensed into the nodes of a small component, with the
+ *    sums of the capacities between them as edges and the sums of the
+ *    demands between them as demands. The flow handlers are run on it.
+ * 2. For each cluster a component is built from the cluster's nodes, the
+ *    nodes outside the cluster they have links to and some virtual nodes:
+ *    One for each cluster the traffic leaves to and one for each cluster of
+ *    origin the traffic passing the cluster comes from. The demands of those
+ *    are derived from the flows of the condensed component. The flow
+ *    handlers are run on these components independently of each other in
+ *    the link graph thread pool and the resulting flows are copied back to
+ *    the nodes of the original component.
+ *
+ * The flows of the traffic passing a cluster are calculated per cluster of
+ * origin instead of per origin. As cargo is routed by origin only this still
+ * gives valid flows for every origin, but they are less precise than the
+ * ones of a flat calculation.
+ */
+class LinkGraphClusters {
+public:
+	static const uint MIN_CLUSTER_SIZE = 16; ///< Minimum number of nodes in a cluster.
+	static const uint MAX_CLUSTERS = 512;    ///< Maximum number of clusters; more won't fit into the virtual station IDs.
+
+	LinkGraphClusters(LinkGraphComponent *component);
+
+	static uint GetClusterSize(const LinkGraphComponent *component);
+
+	/**
+	 * Get the number of clusters.
+	 * @return Number of clusters; 0 if the component isn't decomposed.
+	 */
+	inline uint GetNumClusters() const { return (uint)this->first_node.size() - 1; }
+
+	void Run(ComponentHandler * const *handlers, uint num_handlers, uint64 *cycles);
+
+	/**
+	 * Get the highest estimated memory used by the condensed component and
+	 * the cluster components while calculating them, assuming that all
+	 * clusters are calculated at the same time.
+	 * @return Memory in bytes.
+	 */
+	inline size_t GetPeakMemory() const { return this->peak_memory; }
+
+private:
+	/** Sum of the demands from a cluster of origin to one of a cluster's nodes. */
+	typedef std::map<std::pair<uint, NodeID>, uint> InboundDemandMap;
+
+	/** Link entering a cluster. */
+	struct Entry {
+		uint from_cluster; ///< Cluster the link comes from.
+		NodeID to;         ///< Node of the cluster the link leads to.
+		uint capacity;     ///< Capacity of the link.
+	};
+	typedef std::vector<Entry> EntryVector;
+
+	/** Calculation of one cluster, possibly running in another thread. */
+	struct ClusterTask {
+		LinkGraphClusters *clusters;                    ///< Decomposition the cluster belongs to.
+		uint cluster;                                   ///< Cluster to be calculated.
+		ComponentHandler * const *handlers;             ///< Handlers to be run.
+		uint num_handlers;                              ///< Number of handlers.
+		uint64 cycles[LinkGraphJobStats::MAX_HANDLERS]; ///< CPU ticks spent in each handler.
+		size_t peak_memory;                             ///< Highest estimated memory used by the cluster's component.
+		ThreadPoolTask task;                            ///< Task running the calculation.
+	};
+
+	LinkGraphComponent *component;         ///< Decomposed component.
+	LinkGraphComponent condensed;          ///< Component with one node for each cluster.
+	std::vector<uint> cluster_of;          ///< Cluster of each node.
+	std::vector<NodeID> nodes;             ///< Nodes sorted by cluster.
+	std::vector<uint> first_node;          ///< Position of each cluster's first node in nodes, plus one entry marking the end.
+	std::vector<NodeID> position;          ///< Position of each node within its cluster.
+	std::vector<uint> outbound;            ///< Demand of each node to nodes in other clusters.
+	std::vector<uint64> cluster_outbound;  ///< Demand of each cluster to other clusters.
+	std::vector<EntryVector> entries;      ///< Links entering each cluster.
+	std::vector<InboundDemandMap> inbound; ///< Demands from other clusters to each cluster's nodes.
+	size_t peak_memory;                    ///< Highest estimated memory used by the condensed component and the cluster components.
+
+	void Partition(uint size);
+	void Condense();
+	void CalculateCluster(uint cluster, ComponentHandler * const *handlers, uint num_handlers, uint64 *cycles, size_t &peak_memory);
+	void AddIncomingFlows(NodeID node_id, uint origin, const FlowViaMap &flows);
+	static void RunClusterTask(void *task);
+	static void RunHandlers(LinkGraphComponent *component, ComponentHandler * const *handlers, uint num_handlers, uint64 *cycles, size_t &peak_memory);
+};
+
+#endif /* LINKGRAPH_CLUSTERS_H_ */
@@ -7,69 +7,149 @@
 #include "../cargotype.h"
 #include "../core/math_func.hpp"
 #include "demands.h"
-#include <list>
 
-typedef std::list<NodeID> NodeList;
+/**
+ * Queue of node IDs kept in a ring buffer. The demand calculation never has a
+ * node in the same queue twice, so the buffer never needs more space than
+ * there are nodes in the component.
+ */
+class NodeQueue {
+public:
+	/**
+	 * Create an empty queue.
+	 * @param size Maximum number of nodes in the queue.
+	 */
+	NodeQueue(uint size) : ids(size), head(0), count(0) {}
+
+	/** Check if the queue is empty. */
+	inline bool empty() const { return this->count == 0; }
+
+	/** Get the node at the front of the queue. */
+	inline NodeID front() const { return this->ids[this->head]; }
+
+	/** Remove the node at the front of the queue. */
+	inline void pop_front()
+	{
+		assert(this->count > 0);
+		if (++this->head == this->ids.size()) this->head = 0;
+		--this->count;
+	}
+
+	/**
+	 * Append a node to the end of the queue.
+	 * @param node Node to be appended.
+	 */
+	inline void push_back(NodeID node)
+	{
+		assert(this->count < this->ids.size());
+		uint tail = this->head + this->count;
+		if (tail >= this->ids.size()) tail -= (uint)this->ids.size();
+		this->ids[tail] = node;
+		++this->count;
+	}
+
+private:
+	std::vector<NodeID> ids; ///< Ring buffer holding the queued nodes.
+	uint head;               ///< Position of the front of the queue in ids.
+	uint count;              ///< Number of nodes in the queue.
+};
+
+/**
+ * Take a snapshot of the supply, demand and location of a component's nodes.
+ * @param graph Component to take the snapshot of.
+ */
+DemandNodes::DemandNodes(LinkGraphComponent *graph)
+{
+	uint size = graph->GetSize();
+	this->supply.resize(size);
+	this->demand.resize(size);
+	this->undelivered_supply.resize(size);
+	this->x.resize(size);
+	this->y.resize(size);
+	for (NodeID node = 0; node < size; node++) {
+		const Node &n = graph->GetNode(node);
+		this->supply[node] = n.supply;
+		this->demand[node] = n.demand;
+		this->undelivered_supply[node] = n.undelivered_supply;
+		this->x[node] = TileX(n.xy);
+		this->y[node] = TileY(n.xy);
+	}
+}
+
+/**
+ * Write the undelivered supply back to the component's nodes.
+ * @param graph Component the snapshot was taken of.
+ */
+void DemandNodes::ExportUndeliveredSupply(LinkGraphComponent *graph) const
+{
+	for (NodeID node = 0; node < this->Size(); node++) {
+		graph->GetNode(node).undelivered_supply = this->undelivered_supply[node];
+	}
+}
 
 /**
  * Set the demands between two nodes using the given base demand. In symmetric mode
  * this sets demands in both directions.
  * @param graph The link graph.
+ * @param nodes Snapshot of the link graph's nodes.
  * @param from_id The supplying node.
  * @þaram to_id The receiving node.
  * @param demand_forw Demand calculated for the "forward" direction.
  */
-void SymmetricScaler::SetDemands(LinkGraphComponent *graph, NodeID from_id, NodeID to_id, uint demand_forw)
+void SymmetricScaler::SetDemands(LinkGraphComponent *graph, DemandNodes &nodes, NodeID from_id, NodeID to_id, uint demand_forw)
 {
-	if (graph->GetNode(from_id).demand > 0) {
+	if (nodes.demand[from_id] > 0) {
 		uint demand_back = demand_forw * this->mod_size / 100;
-		uint undelivered = graph->GetNode(to_id).undelivered_supply;
+		uint undelivered = nodes.undelivered_supply[to_id];
 		if (demand_back > undelivered) {
 			demand_back = undelivered;
 			demand_forw = max(1U, demand_back * 100 / this->mod_size);
 		}
-		this->Scaler::SetDemands(graph, to_id, from_id, demand_back);
+		this->Scaler::SetDemands(graph, nodes, to_id, from_id, demand_back);
 	}
 
-	this->Scaler::SetDemands(graph, from_id, to_id, demand_forw);
+	this->Scaler::SetDemands(graph, nodes, from_id, to_id, demand_forw);
 }
 
 /**
  * Set the demands between two nodes using the given base demand. In asymmetric mode
  * this only sets demand in the "forward" direction.
  * @param graph The link graph.
+ * @param nodes Snapshot of the link graph's nodes.
  * @param from_id The supplying node.
  * @þaram to_id The receiving node.
  * @param demand_forw Demand calculated for the "forward" direction.
  */
-inline void Scaler::SetDemands(LinkGraphComponent *graph, NodeID from_id, NodeID to_id, uint demand_forw)
+inline void Scaler::SetDemands(LinkGraphComponent *graph, DemandNodes &nodes, NodeID from_id, NodeID to_id, uint demand_forw)
 {
-	Edge &forward = graph->GetEdge(from_id, to_id);
+	if (demand_forw == 0) return;
+	Demand &forward = graph->GetNode(from_id).demands[to_id];
 	forward.demand += demand_forw;
 	forward.unsatisfied_demand += demand_forw;
-	graph->GetNode(from_id).undelivered_supply -= demand_forw;
+	nodes.undelivered_supply[from_id] -= demand_forw;
 }
 
 /**
  * Do the actual demand calculation, called from constructor.
  * @param graph Component to calculate the demands for.
+ * @param nodes Snapshot of the component's nodes.
  */
 template<class Tscaler>
-void DemandCalculator::CalcDemand(LinkGraphComponent *graph, Tscaler scaler)
+void DemandCalculator::CalcDemand(LinkGraphComponent *graph, DemandNodes &nodes, Tscaler scaler)
 {
-	NodeList supplies;
-	NodeList demands;
+	uint size = nodes.Size();
+	NodeQueue supplies(size);
+	NodeQueue demands(size);
 	uint num_supplies = 0;
 	uint num_demands = 0;
 
-	for (NodeID node = 0; node < graph->GetSize(); node++) {
-		Node &n = graph->GetNode(node);
-		scaler.AddNode(n);
-		if (n.supply > 0) {
+	scaler.Init(nodes);
+	for (NodeID node = 0; node < size; node++) {
+		if (nodes.supply[node] > 0) {
 			supplies.push_back(node);
 			num_supplies++;
 		}
-		if (n.demand > 0) {
+		if (nodes.demand[node] > 0) {
 			demands.push_back(node);
 			num_demands++;
 		}
@@ -88,8 +168,6 @@ void DemandCalculator::CalcDemand(LinkGraphComponent *graph, Tscaler scaler)
 		NodeID node1 = supplies.front();
 		supplies.pop_front();
 
-		Node &from = graph->GetNode(node1);
-
 		for (uint i = 0; i < num_demands; ++i) {
 			assert(!demands.empty());
 			NodeID node2 = demands.front();
@@ -103,14 +181,13 @@ void DemandCalculator::CalcDemand(LinkGraphComponent *graph, Tscaler scaler)
 					continue;
 				}
 			}
-			Node &to = graph->GetNode(node2);
 
-			int32 supply = scaler.EffectiveSupply(from, to);
+			int32 supply = scaler.EffectiveSupply(nodes, node1, node2);
 			assert(supply > 0);
 
 			/* scale the distance by mod_dist around max_distance */
 			int32 distance = this->max_distance - (this->max_distance -
-					(int32)graph->GetEdge(node1, node2).distance) * this->mod_dist / 100;
+					(int32)nodes.Distance(node1, node2)) * this->mod_dist / 100;
 
 			/* scale the accuracy by distance around accuracy / 2 */
 			int32 divisor = this->accuracy * (this->mod_dist - 50) / 100 +
@@ -132,20 +209,20 @@ void DemandCalculator::CalcDemand(LinkGraphComponent *graph, Tscaler scaler)
 				demand_forw = 1;
 			}
 
-			demand_forw = min(demand_forw, from.undelivered_supply);
+			demand_forw = min(demand_forw, nodes.undelivered_supply[node1]);
 
-			scaler.SetDemands(graph, node1, node2, demand_forw);
+			scaler.SetDemands(graph, nodes, node1, node2, demand_forw);
 
-			if (scaler.DemandLeft(to)) {
+			if (scaler.DemandLeft(nodes, node2)) {
 				demands.push_back(node2);
 			} else {
 				num_demands--;
 			}
 
-			if (from.undelivered_supply == 0) break;
+			if (nodes.undelivered_supply[node1] == 0) break;
 
 		}
-		if (from.undelivered_supply != 0) {
+		if (nodes.undelivered_supply[node1] != 0) {
 			supplies.push_back(node1);
 		} else {
 			num_supplies--;
@@ -171,14 +248,16 @@ DemandCalculator::DemandCalculator(LinkGraphComponent *graph) :
 		this->mod_dist = 100 + over100 * over100;
 	}
 
+	DemandNodes nodes(graph);
 	switch (settings.GetDistributionType(cargo)) {
 		case DT_SYMMETRIC:
-			this->CalcDemand<SymmetricScaler>(graph, SymmetricScaler(settings.demand_size));
+			this->CalcDemand<SymmetricScaler>(graph, nodes, SymmetricScaler(settings.demand_size));
 			break;
 		case DT_ASYMMETRIC:
-			this->CalcDemand<AsymmetricScaler>(graph, AsymmetricScaler());
+			this->CalcDemand<AsymmetricScaler>(graph, nodes, AsymmetricScaler());
 			break;
 		default:
 			NOT_REACHED();
 	}
+	nodes.ExportUndeliveredSupply(graph);
 }
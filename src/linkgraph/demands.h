@@ -6,6 +6,44 @@
 #include "linkgraph.h"
 #include "../cargo_type.h"
 #include "../map_func.h"
+#include "../core/math_func.hpp"
+#include <vector>
+
+/**
+ * Snapshot of the nodes' supply, demand and location, kept in one array per
+ * value. The demand calculation only reads those few values for each pair of
+ * nodes, so it doesn't have to drag the paths, flows and demands of the Node
+ * objects through the cache.
+ */
+class DemandNodes {
+public:
+	DemandNodes(LinkGraphComponent *graph);
+
+	void ExportUndeliveredSupply(LinkGraphComponent *graph) const;
+
+	/**
+	 * Get the number of nodes in the snapshot.
+	 * @return Number of nodes.
+	 */
+	inline uint Size() const { return (uint)this->supply.size(); }
+
+	/**
+	 * Get the manhattan distance between two nodes.
+	 * @param from First node.
+	 * @param to Second node.
+	 * @return Distance.
+	 */
+	inline uint Distance(NodeID from, NodeID to) const
+	{
+		return Delta(this->x[from], this->x[to]) + Delta(this->y[from], this->y[to]);
+	}
+
+	std::vector<uint> supply;             ///< Supply of each node.
+	std::vector<uint> demand;             ///< Acceptance of each node.
+	std::vector<uint> undelivered_supply; ///< Supply of each node that hasn't been distributed yet.
+	std::vector<uint> x;                  ///< X coordinate of each node.
+	std::vector<uint> y;                  ///< Y coordinate of each node.
+};
 
 /**
  * Scale various things according to symmetric/asymmetric distribution.
@@ -14,7 +52,7 @@ class Scaler {
 public:
 	Scaler() : demand_per_node(0) {}
 
-	void SetDemands(LinkGraphComponent * graph, NodeID from, NodeID to, uint demand_forw);
+	void SetDemands(LinkGraphComponent *graph, DemandNodes &nodes, NodeID from, NodeID to, uint demand_forw);
 protected:
 	uint demand_per_node; ///< Mean demand associated with each node.
 };
@@ -27,12 +65,23 @@ public:
 	inline SymmetricScaler(uint mod_size) : mod_size(mod_size), supply_sum(0) {}
 
 	/**
-	 * Count a node's supply into the sum of supplies.
-	 * @param node Node.
+	 * Sum up the supplies of all nodes and calculate the weight each node's
+	 * supply gets as remote supply.
+	 * @param nodes Nodes of the component.
 	 */
-	inline void AddNode(const Node &node)
+	inline void Init(const DemandNodes &nodes)
 	{
-		this->supply_sum += node.supply;
+		uint size = nodes.Size();
+		if (size == 0) return;
+		const uint *supply = &nodes.supply[0];
+		this->weight.resize(size);
+		uint *weight = &this->weight[0];
+		uint sum = 0;
+		for (uint i = 0; i < size; ++i) {
+			sum += supply[i];
+			weight[i] = max(1U, supply[i]) * this->mod_size;
+		}
+		this->supply_sum = sum;
 	}
 
 	/**
@@ -47,31 +96,34 @@ public:
 	/**
 	 * Get the effective supply of one node towards another one. In symmetric
 	 * distribution the supply of the other node is weighed in.
+	 * @param nodes Nodes of the component.
 	 * @param from The supplying node.
 	 * @param to The receiving node.
 	 * @return Effective supply.
 	 */
-	inline uint EffectiveSupply(const Node &from, const Node &to)
+	inline uint EffectiveSupply(const DemandNodes &nodes, NodeID from, NodeID to)
 	{
-		return max(from.supply * max(1U, to.supply) * this->mod_size / 100 / this->demand_per_node, 1U);
+		return max(nodes.supply[from] * this->weight[to] / 100 / this->demand_per_node, 1U);
 	}
 
 	/**
 	 * Check if there is any acceptance left for this node. In symmetric distribution
 	 * nodes only accept anything if they also supply something. So if
 	 * undelivered_supply == 0 at the node there isn't any demand left either.
+	 * @param nodes Nodes of the component.
 	 * @param to The node to be checked.
 	 */
-	inline bool DemandLeft(Node &to)
+	inline bool DemandLeft(const DemandNodes &nodes, NodeID to)
 	{
-		return (to.supply == 0 || to.undelivered_supply > 0) && to.demand > 0;
+		return (nodes.supply[to] == 0 || nodes.undelivered_supply[to] > 0) && nodes.demand[to] > 0;
 	}
 
-	void SetDemands(LinkGraphComponent *graph, NodeID from, NodeID to, uint demand_forw);
+	void SetDemands(LinkGraphComponent *graph, DemandNodes &nodes, NodeID from, NodeID to, uint demand_forw);
 
 private:
-	uint mod_size;   ///< Size modifier. Determines how much demands increase with the supply of the remote station
-	uint supply_sum; ///< Sum of all supplies in the component.
+	uint mod_size;            ///< Size modifier. Determines how much demands increase with the supply of the remote station
+	uint supply_sum;          ///< Sum of all supplies in the component.
+	std::vector<uint> weight; ///< Remote supply of each node, multiplied with mod_size.
 };
 
 /**
@@ -82,12 +134,17 @@ public:
 	AsymmetricScaler() : demand_sum(0) {}
 
 	/**
-	 * Count a node's demand into the sum of demands.
-	 * @param node The node to be counted.
+	 * Sum up the demands of all nodes.
+	 * @param nodes Nodes of the component.
 	 */
-	inline void AddNode(const Node &node)
+	inline void Init(const DemandNodes &nodes)
 	{
-		this->demand_sum += node.demand;
+		uint size = nodes.Size();
+		if (size == 0) return;
+		const uint *demand = &nodes.demand[0];
+		uint sum = 0;
+		for (uint i = 0; i < size; ++i) sum += demand[i];
+		this->demand_sum = sum;
 	}
 
 	/**
@@ -102,20 +159,22 @@ public:
 	/**
 	 * Get the effective supply of one node towards another one. In asymmetric
 	 * distribution the demand of the other node is weighed in.
+	 * @param nodes Nodes of the component.
 	 * @param from The supplying node.
 	 * @param to The receiving node.
 	 */
-	inline uint EffectiveSupply(const Node &from, const Node &to)
+	inline uint EffectiveSupply(const DemandNodes &nodes, NodeID from, NodeID to)
 	{
-		return max(from.supply * to.demand / this->demand_per_node, (uint)1);
+		return max(nodes.supply[from] * nodes.demand[to] / this->demand_per_node, (uint)1);
 	}
 
 	/**
 	 * Check if there is any acceptance left for this node. In asymmetric distribution
 	 * nodes always accept as long as their demand > 0.
+	 * @param nodes Nodes of the component.
 	 * @param to The node to be checked.
 	 */
-	inline bool DemandLeft(Node &to) { return to.demand > 0; }
+	inline bool DemandLeft(const DemandNodes &nodes, NodeID to) { return nodes.demand[to] > 0; }
 
 private:
 	uint demand_sum; ///< Sum of all demands in the component.
@@ -135,7 +194,7 @@ private:
 	int32 accuracy;     ///< Accuracy of the calculation.
 
 	template<class Tscaler>
-	void CalcDemand(LinkGraphComponent *graph, Tscaler scaler);
+	void CalcDemand(LinkGraphComponent *graph, DemandNodes &nodes, Tscaler scaler);
 };
 
 /**
@@ -150,6 +209,12 @@ public:
 	 */
 	virtual void Run(LinkGraphComponent *graph) { DemandCalculator c(graph); }
 
+	/**
+	 * Get the name of the handler.
+	 * @return Name.
+	 */
+	virtual const char *GetName() const { return "demands"; }
+
 	/**
 	 * Virtual destructor has to be defined because of virtual Run().
 	 */
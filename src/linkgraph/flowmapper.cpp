@@ -10,6 +10,7 @@
 /** @file flowmapper.cpp Definition of flowmapper. */
 
 #include "../stdafx.h"
+#include "../map_func.h"
 #include "flowmapper.h"
 
 /**
@@ -21,8 +22,8 @@ void FlowMapper::Run(LinkGraphComponent *component)
 	for (NodeID node_id = 0; node_id < component->GetSize(); ++node_id) {
 		Node &prev_node = component->GetNode(node_id);
 		StationID prev = prev_node.station;
-		PathSet &paths = prev_node.paths;
-		for (PathSet::iterator i = paths.begin(); i != paths.end(); ++i) {
+		PathList &paths = prev_node.paths;
+		for (PathList::iterator i = paths.begin(); i != paths.end(); ++i) {
 			Path *path = *i;
 			uint flow = path->GetFlow();
 			if (flow == 0) continue;
@@ -44,11 +45,82 @@ void FlowMapper::Run(LinkGraphComponent *component)
 			}
 		}
 	}
+	/* No handler keeps any paths beyond this point, so all of them can be dropped. */
 	for (NodeID node_id = 0; node_id < component->GetSize(); ++node_id) {
-		PathSet &paths = component->GetNode(node_id).paths;
-		for (PathSet::iterator i = paths.begin(); i != paths.end(); ++i) {
-			delete *i;
+		component->GetNode(node_id).paths.clear();
+	}
+	component->GetPathArena().Reset();
+}
+
+/**
+ * Calculation of the route distances of one component. It's kept apart from
+ * the RouteMapper as handlers are shared between all jobs.
+ */
+class RouteDistanceCalculator {
+public:
+	/**
+	 * Prepare the calculation for a component.
+	 * @param component Component to calculate the route distances for.
+	 */
+	RouteDistanceCalculator(LinkGraphComponent *component) : component(component)
+	{
+		for (NodeID node_id = 0; node_id < component->GetSize(); ++node_id) {
+			this->nodes[component->GetNode(node_id).station] = node_id;
+		}
+	}
+
+	uint GetDistance(NodeID node_id, StationID origin);
+
+private:
+	LinkGraphComponent *component;     ///< Component to calculate the route distances for.
+	std::map<StationID, NodeID> nodes; ///< Nodes by station.
+};
+
+/**
+ * Get the mean distance of the routes of cargo from an origin from a node
+ * to its destinations, weighted by their flows. Distances already calculated
+ * are looked up; others are calculated from the ones of the next hops. A
+ * circular flow counts as ending where it meets itself again.
+ * @param node_id Node to start at.
+ * @param origin Station the cargo comes from.
+ * @return Distance in tiles.
+ */
+uint RouteDistanceCalculator::GetDistance(NodeID node_id, StationID origin)
+{
+	Node &node = this->component->GetNode(node_id);
+	std::pair<RouteDistanceMap::iterator, bool> inserted = node.route_distances.insert(std::make_pair(origin, 0U));
+	if (!inserted.second) return inserted.first->second;
+
+	FlowMap::const_iterator flows = node.flows.find(origin);
+	if (flows == node.flows.end()) return 0;
+
+	uint64 total_flow = 0;
+	uint64 total_distance = 0;
+	for (FlowViaMap::const_iterator via = flows->second.begin(); via != flows->second.end(); ++via) {
+		if (via->second <= 0) continue;
+		total_flow += via->second;
+		if (via->first == node.station) continue;
+
+		std::map<StationID, NodeID>::const_iterator next = this->nodes.find(via->first);
+		if (next == this->nodes.end()) continue;
+		uint distance = DistanceManhattan(node.xy, this->component->GetNode(next->second).xy);
+		total_distance += (uint64)via->second * (distance + this->GetDistance(next->second, origin));
+	}
+	if (total_flow > 0) inserted.first->second = (uint)(total_distance / total_flow);
+	return inserted.first->second;
+}
+
+/**
+ * Calculate the route distances for all origins at all nodes.
+ * @param component the link graph component to be used.
+ */
+void RouteMapper::Run(LinkGraphComponent *component)
+{
+	RouteDistanceCalculator calculator(component);
+	for (NodeID node_id = 0; node_id < component->GetSize(); ++node_id) {
+		const FlowMap &flows = component->GetNode(node_id).flows;
+		for (FlowMap::const_iterator i = flows.begin(); i != flows.end(); ++i) {
+			calculator.GetDistance(node_id, i->first);
 		}
-		paths.clear();
 	}
 }
@@ -25,6 +25,37 @@ class FlowMapper : public ComponentHandler {
 public:
 	virtual ~FlowMapper() {}
 	virtual void Run(LinkGraphComponent *component);
+
+	/**
+	 * Get the name of the handler.
+	 * @return Name.
+	 */
+	virtual const char *GetName() const { return "flows"; }
+
+	/**
+	 * The flows are mapped from the paths only.
+	 * @return true.
+	 */
+	virtual bool RunsOnClusters() const { return true; }
+};
+
+/**
+ * Calculate the mean distance of the planned routes from each node to the
+ * destinations of the cargo passing it, for each origin, by following the
+ * flows. The flows at a node already are the table of next hops by origin;
+ * together with these distances the station can tell how far cargo still
+ * has to go without following its route station by station.
+ */
+class RouteMapper : public ComponentHandler {
+public:
+	virtual ~RouteMapper() {}
+	virtual void Run(LinkGraphComponent *component);
+
+	/**
+	 * Get the name of the handler.
+	 * @return Name.
+	 */
+	virtual const char *GetName() const { return "routes"; }
 };
 
 #endif /* FLOWMAPPER_H_ */
@@ -16,11 +16,20 @@
 #include "../window_func.h"
 #include "../window_gui.h"
 #include "../moving_average.h"
+#include "../network/network_admin.h"
 #include "linkgraph.h"
 #include "demands.h"
 #include "mcf.h"
 #include "flowmapper.h"
+#include "clusters.h"
 #include <queue>
+#include <algorithm>
+
+/**
+ * Thread pool running the link graph jobs. It has to be defined before the
+ * link graphs so that it's destroyed after them, when all jobs are joined.
+ */
+ThreadPool LinkGraphJob::_thread_pool;
 
 /**
  * Global array of link graphs, one for each cargo.
@@ -37,34 +46,42 @@ LinkGraphJob::HandlerList LinkGraphJob::_handlers;
  * @param st ID of the associated station.
  * @param sup Supply of cargo at the station last month.
  * @param dem Acceptance for cargo at the station.
+ * @param xy Location of the station.
  */
-inline void Node::Init(StationID st, uint sup, uint dem)
+void Node::Init(StationID st, uint sup, uint dem, TileIndex xy)
 {
 	this->supply = sup;
 	this->undelivered_supply = sup;
 	this->demand = dem;
 	this->station = st;
+	this->xy = xy;
 
-	for (PathSet::iterator i = this->paths.begin(); i != this->paths.end(); ++i) {
-		delete *i;
-	}
 	this->paths.clear();
 	this->flows.clear();
+	this->route_distances.clear();
+	this->demands.clear();
 }
 
 /**
- * Create an edge.
- * @param distance Length of the link as manhattan distance.
- * @param capacity Capacity of the link.
+ * Comparator for finding edges by destination in a sorted edge list.
+ * @param edge Edge to be compared.
+ * @param to Destination node to be compared with.
+ * @return If the edge's destination is lower than to.
  */
-inline void Edge::Init(uint distance, uint capacity)
+static inline bool EdgeDestinationLess(const Edge &edge, NodeID to)
 {
-	this->distance = distance;
-	this->capacity = capacity;
-	this->demand = 0;
-	this->unsatisfied_demand = 0;
-	this->flow = 0;
-	this->next_edge = INVALID_NODE;
+	return edge.to < to;
+}
+
+/**
+ * Comparator for sorting edges by destination.
+ * @param a First edge.
+ * @param b Second edge.
+ * @return If a's destination is lower than b's.
+ */
+static inline bool EdgeLess(const Edge &a, const Edge &b)
+{
+	return a.to < b.to;
 }
 
 
@@ -106,7 +123,97 @@ void LinkGraph::CreateComponent(Station *first)
 	}
 
 	/* here the list of nodes and edges for this component is complete. */
-	this->SpawnThread();
+	this->CompressEdges();
+
+	/* Signatures of components which have been merged into this one are stale. */
+	for (NodeID node = 1; node < this->GetSize(); ++node) {
+		this->signatures.erase(this->GetNode(node).station);
+	}
+
+	/* If nothing has changed beyond the configured tolerance since the last
+	 * calculation, the flows from that one are still good. */
+	uint64 signature = this->CalculateSignature();
+	std::pair<SignatureMap::iterator, bool> last = this->signatures.insert(std::make_pair(first->index, signature));
+	if (!last.second) {
+		if (last.first->second == signature) {
+			DEBUG(misc, 2, "Link graph component for cargo %d at station %d is unchanged; skipping", this->cargo, first->index);
+			this->LinkGraphComponent::Clear();
+			return;
+		}
+		last.first->second = signature;
+	}
+
+	this->SetJoinDate(this->EstimateDuration());
+	this->Spawn();
+}
+
+/**
+ * Round a value down to a number of significant bits, so that changes smaller
+ * than the given tolerance usually don't change the result.
+ * @param value Value to be rounded.
+ * @param tolerance Tolerance in percent; 0 to keep the exact value.
+ * @return Rounded value.
+ */
+static uint RoundToTolerance(uint value, uint tolerance)
+{
+	if (tolerance == 0) return value;
+
+	/* Keep enough bits below the leading one for steps of at most tolerance
+	 * percent of the value: 1 / 2^bits <= tolerance / 100. */
+	uint bits = 0;
+	while ((tolerance << bits) < 100) bits++;
+	if (value < (1U << bits)) return value;
+
+	uint shift = FindLastBit(value) - bits;
+	return (value >> shift) << shift;
+}
+
+/**
+ * Mix a value into a signature.
+ * @param signature Signature to be changed.
+ * @param value Value to be added.
+ */
+static inline void AddToSignature(uint64 &signature, uint value)
+{
+	signature = (signature ^ value) * 1099511628211ULL;
+}
+
+/**
+ * Calculate a signature of everything a job on the current component depends
+ * on: stations, their locations, supply and acceptance, links and their
+ * capacities as well as the settings used. Supply and capacities are rounded
+ * according to the recalc_tolerance setting.
+ * @return Signature of the component.
+ */
+uint64 LinkGraph::CalculateSignature() const
+{
+	uint tolerance = this->settings.recalc_tolerance;
+	uint64 signature = 14695981039346656037ULL;
+
+	AddToSignature(signature, this->settings.GetDistributionType(this->cargo));
+	AddToSignature(signature, this->settings.accuracy);
+	AddToSignature(signature, this->settings.demand_size);
+	AddToSignature(signature, this->settings.demand_distance);
+	AddToSignature(signature, this->settings.short_path_saturation);
+	AddToSignature(signature, this->settings.max_mcf_rounds);
+	AddToSignature(signature, this->settings.cluster_size);
+	AddToSignature(signature, this->num_nodes);
+
+	for (NodeID from = 0; from < this->num_nodes; ++from) {
+		const Node &node = this->nodes[from];
+		AddToSignature(signature, node.station);
+		AddToSignature(signature, node.xy);
+		AddToSignature(signature, node.demand);
+		AddToSignature(signature, RoundToTolerance(node.supply, tolerance));
+		AddToSignature(signature, this->first_edge[from + 1] - this->first_edge[from]);
+	}
+
+	for (EdgeVector::const_iterator i = this->edges.begin(); i != this->edges.end(); ++i) {
+		AddToSignature(signature, i->to);
+		AddToSignature(signature, RoundToTolerance(i->capacity, tolerance));
+	}
+
+	return signature;
 }
 
 /**
@@ -175,16 +282,37 @@ void LinkGraph::NextComponent()
 	} while (this->current_station_id != last_station_id);
 }
 
+/**
+ * Estimate the number of days a job on the current component will take. The
+ * estimate is the larger of the recalculation interval and the time it takes
+ * to do nodes * (nodes + edges) units of work at the configured job speed.
+ * If the component is decomposed into clusters, searching the paths from a
+ * node only covers about two clusters, so the work is reduced accordingly.
+ * It must only depend on the component and its settings, so that all clients
+ * arrive at the same join date.
+ * @return Expected duration of the job in days.
+ */
+uint LinkGraph::EstimateDuration() const
+{
+	uint64 size = this->GetSize();
+	uint64 cluster_size = LinkGraphClusters::GetClusterSize(this);
+	uint64 span = cluster_size == 0 ? size : 2 * cluster_size;
+	uint64 work = span * (size + this->edges.size());
+	uint64 work_per_day = (uint64)this->settings.job_speed * 1000;
+	uint64 days = (work + work_per_day - 1) / work_per_day;
+	return (uint)Clamp<uint64>(days, this->settings.recalc_interval, UINT16_MAX);
+}
+
 /**
  * Spawn or join a link graph component if any link graph is due to do so.
  * Spawning is done on COMPONENTS_SPAWN_TICK every day, joining on
- * COMPONENT_JOIN_TICK. Each link graph is due every recalc_interval days.
+ * COMPONENT_JOIN_TICK. Each link graph is due to spawn every recalc_interval
+ * days, unless its last job is still running. Jobs are joined on their join
+ * date.
  */
 void OnTick_LinkGraph()
 {
-	if (_date_fract == LinkGraph::COMPONENTS_SPAWN_TICK ||
-			_date_fract == LinkGraph::COMPONENTS_JOIN_TICK) {
-
+	if (_date_fract == LinkGraph::COMPONENTS_SPAWN_TICK) {
 		/* This creates a fair distribution of all link graphs' turns over
 		 * the available dates.
 		 */
@@ -194,20 +322,21 @@ void OnTick_LinkGraph()
 			/* don't calculate a link graph if the distribution is manual */
 			if (_settings_game.linkgraph.GetDistributionType(cargo) == DT_MANUAL) continue;
 
-			if (_date_fract == LinkGraph::COMPONENTS_SPAWN_TICK) {
-				_link_graphs[cargo].NextComponent();
-			} else /* LinkGraph::COMPONENTS_JOIN_TICK */ {
-				_link_graphs[cargo].Join();
-			}
+			_link_graphs[cargo].NextComponent();
+		}
+	} else if (_date_fract == LinkGraph::COMPONENTS_JOIN_TICK) {
+		for (CargoID cargo = 0; cargo < NUM_CARGO; ++cargo) {
+			if (_settings_game.linkgraph.GetDistributionType(cargo) == DT_MANUAL) continue;
+
+			if (_link_graphs[cargo].IsJoinDue()) _link_graphs[cargo].Join();
 		}
 	}
 }
 
 /**
- * Add a node to the component and create empty edges associated with it. Set
- * the station's last_component to this component. Calculate the distances to all
- * other nodes. The distances to _all_ nodes are important as the demand
- * calculator relies on their availability.
+ * Add a node to the component. Set the station's last_component to this
+ * component. The station's location is recorded so that distances to other
+ * nodes can be calculated without keeping them all in memory.
  * @param st New node's station.
  * @return New node's ID.
  */
@@ -216,71 +345,127 @@ NodeID LinkGraphComponent::AddNode(Station *st)
 	GoodsEntry &good = st->goods[this->cargo];
 	good.last_component = this->index;
 
-	bool do_resize = (this->nodes.size() == this->num_nodes);
-
-	if (do_resize) {
-		this->nodes.push_back(Node());
-		this->edges.push_back(std::vector<Edge>(this->num_nodes + 1));
-	}
-
-	this->nodes[this->num_nodes].Init(st->index, good.supply,
-			HasBit(good.acceptance_pickup, GoodsEntry::GES_ACCEPTANCE));
+	return this->AddNode(st->index, good.supply,
+			HasBit(good.acceptance_pickup, GoodsEntry::GES_ACCEPTANCE), st->xy);
+}
 
-	std::vector<Edge> &new_edges = this->edges[this->num_nodes];
+/**
+ * Add a node with the given properties to the component without touching any
+ * station. Used for components which don't exist in the game.
+ * @param st ID of the node's station.
+ * @param supply Supply at the station.
+ * @param demand Acceptance at the station.
+ * @param xy Location of the station.
+ * @return New node's ID.
+ */
+NodeID LinkGraphComponent::AddNode(StationID st, uint supply, uint demand, TileIndex xy)
+{
+	if (this->nodes.size() == this->num_nodes) this->nodes.push_back(Node());
 
-	/* reset the first edge starting at the new node */
-	new_edges[this->num_nodes].next_edge = INVALID_NODE;
+	this->nodes[this->num_nodes].Init(st, supply, demand, xy);
 
-	for (NodeID i = 0; i < this->num_nodes; ++i) {
-		uint distance = DistanceManhattan(st->xy, Station::Get(this->nodes[i].station)->xy);
-		if (do_resize) this->edges[i].push_back(Edge());
-		new_edges[i].Init(distance);
-		this->edges[i][this->num_nodes].Init(distance);
-	}
 	return this->num_nodes++;
 }
 
 /**
- * Fill an edge with values from a link.
+ * Append an edge for a link to the component. Edges have to be added in
+ * ascending order of their source nodes, so that all edges of one node are
+ * adjacent. CompressEdges has to be called after all edges have been added.
  * @param from Source node of the link.
  * @param to Destination node of the link.
  * @param capacity Capacity of the link.
  */
-inline void LinkGraphComponent::AddEdge(NodeID from, NodeID to, uint capacity)
+void LinkGraphComponent::AddEdge(NodeID from, NodeID to, uint capacity)
 {
 	assert(from != to);
-	Edge &edge = this->edges[from][to];
-	Edge &first = this->edges[from][from];
-	edge.capacity = capacity;
-	edge.next_edge = first.next_edge;
-	first.next_edge = to;
+	assert(from + 1 >= this->first_edge.size());
+	while (this->first_edge.size() <= from) this->first_edge.push_back((uint)this->edges.size());
+
+	this->edges.push_back(Edge());
+	this->edges.back().Init(to, capacity);
+}
+
+/**
+ * Finish the edge list after all edges have been added: Terminate the row
+ * index, sort each node's edges by destination, so that GetEdge can use
+ * binary search, and calculate the edges' distances from the nodes' locations.
+ */
+void LinkGraphComponent::CompressEdges()
+{
+	while (this->first_edge.size() <= this->num_nodes) this->first_edge.push_back((uint)this->edges.size());
+
+	for (NodeID from = 0; from < this->num_nodes; ++from) {
+		EdgeIterator begin = this->GetFirstEdge(from);
+		EdgeIterator end = this->GetEdgesEnd(from);
+		std::sort(begin, end, &EdgeLess);
+		TileIndex xy = this->nodes[from].xy;
+		for (EdgeIterator i = begin; i != end; ++i) {
+			assert(i->to < this->num_nodes && i->to != from);
+			i->distance = DistanceManhattan(xy, this->nodes[i->to].xy);
+		}
+	}
+}
+
+/**
+ * Estimate the memory held by the component: nodes, edges, the path arena
+ * and the paths, flows and demands stored in the nodes. Temporary data of
+ * the handlers isn't included.
+ * @return Estimated memory in bytes.
+ */
+size_t LinkGraphComponent::GetMemoryUsage()
+{
+	/* Rough per-item overhead of std::map, in addition to the item itself. */
+	static const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void *);
+
+	size_t memory = this->nodes.capacity() * sizeof(Node) + this->edges.capacity() * sizeof(Edge) +
+			this->first_edge.capacity() * sizeof(uint) + this->path_arena.GetMemoryUsage();
+
+	for (NodeID node_id = 0; node_id < this->num_nodes; ++node_id) {
+		const Node &node = this->nodes[node_id];
+		memory += node.paths.capacity() * sizeof(Path *);
+		memory += node.demands.size() * (sizeof(DemandMap::value_type) + TREE_NODE_OVERHEAD);
+		for (FlowMap::const_iterator i = node.flows.begin(); i != node.flows.end(); ++i) {
+			memory += sizeof(FlowMap::value_type) + TREE_NODE_OVERHEAD;
+			memory += i->second.size() * (sizeof(FlowViaMap::value_type) + TREE_NODE_OVERHEAD);
+		}
+		memory += node.route_distances.size() * (sizeof(RouteDistanceMap::value_type) + TREE_NODE_OVERHEAD);
+	}
+	return memory;
+}
+
+/**
+ * Get a reference to the edge between two nodes. There has to be a link
+ * between the nodes.
+ * @param from Origin node.
+ * @param to Destination node.
+ * @return Edge between from and to.
+ */
+Edge &LinkGraphComponent::GetEdge(NodeID from, NodeID to)
+{
+	EdgeIterator end = this->GetEdgesEnd(from);
+	EdgeIterator edge = std::lower_bound(this->GetFirstEdge(from), end, to, &EdgeDestinationLess);
+	assert(edge != end && edge->to == to);
+	return *edge;
 }
 
 /**
- * Resize the component and fill it with empty nodes and edges. Used when
- * loading from save games.
+ * Resize the component and fill it with empty nodes. Used when loading from
+ * save games. The edges have to be added with AddEdge afterwards.
  *
- * WARNING: The nodes and edges are expected to contain anything while
- * num_nodes is expected to contain the desired size. Normally this is an
- * invalid state, but just after loading the component's structure it is valid.
+ * WARNING: The nodes are expected to contain anything while num_nodes is
+ * expected to contain the desired size. Normally this is an invalid state, but
+ * just after loading the component's structure it is valid.
  * This method should only be called from Load_LGRP.
  */
 void LinkGraphComponent::SetSize()
 {
-	if (this->nodes.size() < this->num_nodes) {
-		for (EdgeMatrix::iterator i = this->edges.begin(); i != this->edges.end(); ++i) {
-			i->resize(this->num_nodes);
-		}
-		this->nodes.resize(this->num_nodes);
-		this->edges.resize(this->num_nodes, std::vector<Edge>(this->num_nodes));
-	}
+	if (this->nodes.size() < this->num_nodes) this->nodes.resize(this->num_nodes);
 
 	for (uint i = 0; i < this->num_nodes; ++i) {
 		this->nodes[i].Init();
-		for (uint j = 0; j < this->num_nodes; ++j) {
-			this->edges[i][j].Init();
-		}
 	}
+	this->edges.clear();
+	this->first_edge.clear();
 }
 
 /**
@@ -293,6 +478,21 @@ LinkGraphComponent::LinkGraphComponent() :
 		index(INVALID_LINKGRAPH_COMPONENT)
 {}
 
+/**
+ * Create an empty component with the given settings. Used for components
+ * which are created while a job is running, as the job must not read the
+ * global settings.
+ * @param settings Settings to be used.
+ * @param cargo Cargo of the component.
+ * @param id ID of the component.
+ */
+LinkGraphComponent::LinkGraphComponent(const LinkGraphSettings &settings, CargoID cargo, LinkGraphComponentID id) :
+		settings(settings),
+		cargo(cargo),
+		num_nodes(0),
+		index(id)
+{}
+
 /**
  * (Re-)initialize this component with a new ID and a new copy of the settings.
  */
@@ -344,6 +544,10 @@ void Node::ExportFlows(FlowMap::iterator &it, FlowStatMap &station_flows, CargoI
 	
 	assert(source_flows.empty());
 
+	if (dest != NULL) {
+		RouteDistanceMap::const_iterator distance = this->route_distances.find(source);
+		if (distance != this->route_distances.end()) dest->SetDistance(distance->second);
+	}
 	this->flows.erase(it++);
 }
 
@@ -361,6 +565,7 @@ void Node::ExportFlows(CargoID cargo)
 		ExportFlows(it, station_flows, cargo);
 	}
 	assert(this->flows.empty());
+	this->route_distances.clear();
 }
 
 /**
@@ -368,7 +573,20 @@ void Node::ExportFlows(CargoID cargo)
  */
 void LinkGraph::Join()
 {
+	this->stats.join_blocked = !this->IsFinished();
+	if (this->stats.join_blocked) {
+		DEBUG(misc, 1, "Link graph job for cargo %d with %u nodes is late; waiting for it", this->cargo, this->GetSize());
+	}
+	uint64 start = ottd_rdtsc();
 	this->LinkGraphJob::Join();
+	this->stats.join_cycles = ottd_rdtsc() - start;
+	this->stats.join_date = _date;
+
+	this->stats_history.push_back(this->stats);
+	if (this->stats_history.size() > STATS_HISTORY_LENGTH) this->stats_history.pop_front();
+#ifdef ENABLE_NETWORK
+	NetworkAdminLinkGraph(this->cargo, this->stats);
+#endif /* ENABLE_NETWORK */
 
 	for (NodeID node_id = 0; node_id < this->GetSize(); ++node_id) {
 		Node &node = this->GetNode(node_id);
@@ -382,17 +600,61 @@ void LinkGraph::Join()
 }
 
 /**
- * Run all handlers for the given Job.
+ * Run all handlers for the given Job. If the job's component is big enough
+ * to be decomposed into clusters, the consecutive handlers which can run on
+ * clusters are run on those; the handlers before and after them are run on
+ * the whole component.
  * @param j Pointer to a link graph job.
  */
 /* static */ void LinkGraphJob::RunLinkGraphJob(void *j)
 {
 	LinkGraphJob *job = (LinkGraphJob *)j;
-	for (HandlerList::iterator i = _handlers.begin(); i != _handlers.end(); ++i) {
+	LinkGraphJobStats &stats = job->stats;
+	stats.peak_memory = job->GetMemoryUsage();
+	LinkGraphClusters clusters(job);
+	bool decomposed = clusters.GetNumClusters() > 0;
+	uint index = 0;
+	HandlerList::iterator i = _handlers.begin();
+	for (; i != _handlers.end() && !(decomposed && (*i)->RunsOnClusters()); ++i, ++index) {
+		uint64 start = ottd_rdtsc();
 		(*i)->Run(job);
+		stats.handler_cycles[index] = ottd_rdtsc() - start;
+		stats.peak_memory = max(stats.peak_memory, job->GetMemoryUsage());
+	}
+	if (i == _handlers.end()) return;
+
+	ComponentHandler *handlers[LinkGraphJobStats::MAX_HANDLERS];
+	uint num_handlers = 0;
+	for (; i != _handlers.end() && (*i)->RunsOnClusters(); ++i) {
+		handlers[num_handlers++] = *i;
+	}
+	clusters.Run(handlers, num_handlers, stats.handler_cycles + index);
+	stats.peak_memory = max(stats.peak_memory, job->GetMemoryUsage() + clusters.GetPeakMemory());
+	DEBUG(misc, 2, "Link graph job for cargo %d with %u nodes was calculated in %u clusters", job->GetCargo(), job->GetSize(), clusters.GetNumClusters());
+
+	/* The clusters can only be calculated once; the remaining handlers run on the whole component. */
+	for (index += num_handlers; i != _handlers.end(); ++i, ++index) {
+		assert(!(*i)->RunsOnClusters());
+		uint64 start = ottd_rdtsc();
+		(*i)->Run(job);
+		stats.handler_cycles[index] = ottd_rdtsc() - start;
+		stats.peak_memory = max(stats.peak_memory, job->GetMemoryUsage());
 	}
 }
 
+/**
+ * Get the name of a handler.
+ * @param index Position of the handler in the list of handlers.
+ * @return Name of the handler or NULL if there is no such handler.
+ */
+/* static */ const char *LinkGraphJob::GetHandlerName(uint index)
+{
+	for (HandlerList::iterator i = _handlers.begin(); i != _handlers.end(); ++i) {
+		if (index-- == 0) return (*i)->GetName();
+	}
+	return NULL;
+}
+
 /**
  * Clear the handlers.
  */
@@ -446,8 +708,9 @@ uint Path::AddFlow(uint new_flow, LinkGraphComponent *graph, bool only_positive)
 			}
 		}
 		new_flow = this->parent->AddFlow(new_flow, graph, only_positive);
-		if (new_flow > 0) {
-			graph->GetNode(this->parent->node).paths.insert(this);
+		if (new_flow > 0 && !this->listed) {
+			graph->GetNode(this->parent->node).paths.push_back(this);
+			this->listed = true;
 		}
 		edge.flow += new_flow;
 	}
@@ -465,39 +728,66 @@ Path::Path(NodeID n, bool source) :
 	capacity(0),
 	free_capacity(source ? INT_MAX : INT_MIN),
 	flow(0), node(n), origin(source ? n : INVALID_NODE),
-	num_children(0), parent(NULL)
+	num_children(0), parent(NULL), listed(false)
 {}
 
 /**
- * Join the calling thread with this job's thread if threading is enabled.
+ * Get memory for a new path. The path has to be constructed with placement
+ * new. Must only be called from the thread running the component's job.
+ * @return Uninitialized memory for one path.
  */
-inline void LinkGraphJob::Join()
+Path *PathArena::Allocate()
 {
-	if (this->thread == NULL) return;
-	this->thread->Join();
-	delete this->thread;
-	this->thread = NULL;
+	uint block = this->used / BLOCK_SIZE;
+	if (block == this->blocks.size()) this->blocks.push_back(MallocT<Path>(BLOCK_SIZE));
+	return this->blocks[block] + (this->used++ % BLOCK_SIZE);
 }
 
 /**
- * Spawn a thread if possible and run the link graph job in the thread. If
- * that's not possible run the job right now in the current thread.
+ * Drop all paths and free the memory.
  */
-void LinkGraphJob::SpawnThread()
+void PathArena::Free()
 {
-	assert(this->thread == NULL);
-	if (!ThreadObject::New(&(LinkGraphJob::RunLinkGraphJob), this, &(this->thread))) {
-		this->thread = NULL;
-		/* Of course this will hang a bit.
-		 * On the other hand, if you want to play games which make this hang noticably
-		 * on a platform without threads then you'll probably get other problems first.
-		 * OK:
-		 * If someone comes and tells me that this hangs for him/her, I'll implement a
-		 * smaller grained "Step" method for all handlers and add some more ticks where
-		 * "Step" is called. No problem in principle.
-		 */
-		LinkGraphJob::RunLinkGraphJob(this);
+	for (std::vector<Path *>::iterator i = this->blocks.begin(); i != this->blocks.end(); ++i) {
+		free(*i);
 	}
+	this->blocks.clear();
+	this->used = 0;
+}
+
+/**
+ * Get the memory allocated by the arena.
+ * @return Size of all blocks in bytes.
+ */
+size_t PathArena::GetMemoryUsage() const
+{
+	return this->blocks.size() * BLOCK_SIZE * sizeof(Path);
+}
+
+/**
+ * Wait for the job to be finished by the thread pool.
+ */
+inline void LinkGraphJob::Join()
+{
+	LinkGraphJob::_thread_pool.Wait(&this->task);
+}
+
+/**
+ * Queue the job in the link graph thread pool. If threads aren't available
+ * the job is run right now in the current thread.
+ */
+void LinkGraphJob::Spawn()
+{
+	this->stats.component = this->index;
+	this->stats.nodes = this->GetSize();
+	this->stats.edges = (uint)this->edges.size();
+	this->stats.num_handlers = (uint)LinkGraphJob::_handlers.size();
+	for (uint i = 0; i < LinkGraphJobStats::MAX_HANDLERS; ++i) this->stats.handler_cycles[i] = 0;
+	this->stats.join_cycles = 0;
+	this->stats.join_blocked = false;
+	this->stats.peak_memory = 0;
+
+	LinkGraphJob::_thread_pool.Start(&this->task, &LinkGraphJob::RunLinkGraphJob, this);
 }
 
 /**
@@ -509,6 +799,8 @@ void LinkGraph::Init(CargoID cargo)
 {
 	this->LinkGraphJob::Join();
 	this->LinkGraphComponent::Clear();
+	this->signatures.clear();
+	this->stats_history.clear();
 
 	this->current_station_id = 0;
 	this->LinkGraphComponent::cargo = cargo;
@@ -527,4 +819,5 @@ void InitializeLinkGraphs()
 	LinkGraphJob::AddHandler(new FlowMapper);
 	LinkGraphJob::AddHandler(new MCFHandler<MCF2ndPass>);
 	LinkGraphJob::AddHandler(new FlowMapper);
+	LinkGraphJob::AddHandler(new RouteMapper);
 }
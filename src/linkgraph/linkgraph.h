@@ -14,21 +14,38 @@
 
 #include "../station_base.h"
 #include "../cargo_type.h"
-#include "../thread/thread.h"
 #include "../settings_type.h"
 #include "../date_func.h"
 #include "linkgraph_type.h"
+#include "threadpool.h"
 #include <list>
 #include <vector>
 #include <set>
+#include <deque>
 
 struct SaveLoad;
 class Path;
 
-typedef std::set<Path *> PathSet;
+typedef std::vector<Path *> PathList;
 typedef std::map<NodeID, Path *> PathViaMap;
 typedef std::map<StationID, int> FlowViaMap;
 typedef std::map<StationID, FlowViaMap> FlowMap;
+typedef std::map<StationID, uint> RouteDistanceMap;
+
+/**
+ * Demand between two nodes of the link graph. Demands are assigned to any
+ * pair of nodes, no matter if there is a direct link between them. Only pairs
+ * with any demand are stored.
+ */
+class Demand {
+public:
+	uint demand;             ///< Transport demand between the nodes.
+	uint unsatisfied_demand; ///< Demand between the nodes that hasn't been satisfied yet.
+
+	Demand() : demand(0), unsatisfied_demand(0) {}
+};
+
+typedef std::map<NodeID, Demand> DemandMap;
 
 /**
  * Node of the link graph. contains all relevant information from the associated
@@ -41,15 +58,13 @@ public:
 	uint undelivered_supply; ///< Amount of supply that hasn't been distributed yet.
 	uint demand;             ///< Acceptance at the station.
 	StationID station;       ///< Station ID.
-	PathSet paths;           ///< Paths through this node.
+	TileIndex xy;            ///< Location of the station at the time the node was created.
+	PathList paths;          ///< Paths through this node, in the order they were first given flow.
 	FlowMap flows;           ///< Planned flows to other nodes.
+	RouteDistanceMap route_distances; ///< Mean distance of the planned routes from here, by origin.
+	DemandMap demands;       ///< Demands to other nodes, ordered by destination.
 
-	/**
-	 * Clear a node on destruction to delete paths that might remain.
-	 */
-	~Node() {this->Init();}
-
-	void Init(StationID st = INVALID_STATION, uint sup = 0, uint dem = 0);
+	void Init(StationID st = INVALID_STATION, uint sup = 0, uint dem = 0, TileIndex xy = INVALID_TILE);
 	void ExportFlows(CargoID cargo);
 
 private:
@@ -57,21 +72,68 @@ private:
 };
 
 /**
- * An edge in the link graph. Corresponds to a link between two stations or at
- * least the distance between them. Edges from one node to itself contain the
- * ID of the opposite Node of the first active edge (i.e. not just distance) in
- * the column as next_edge.
+ * An edge in the link graph. Corresponds to a link between two stations. Only
+ * edges for actual links are stored; the source node is implied by the
+ * position of the edge in the component's edge list.
  */
 class Edge {
 public:
+	NodeID to;               ///< Destination of the link.
 	uint distance;           ///< Length of the link.
 	uint capacity;           ///< Capacity of the link.
-	uint demand;             ///< Transport demand between the nodes.
-	uint unsatisfied_demand; ///< Demand over this edge that hasn't been satisfied yet.
 	uint flow;               ///< Planned flow over this edge.
-	NodeID next_edge;        ///< Destination of next valid edge starting at the same source node.
 
-	void Init(uint distance = 0, uint capacity = 0);
+	/**
+	 * Create an edge. The distance is filled in by LinkGraphComponent::CompressEdges.
+	 * @param to Destination of the link.
+	 * @param capacity Capacity of the link.
+	 */
+	inline void Init(NodeID to = INVALID_NODE, uint capacity = 0)
+	{
+		this->to = to;
+		this->distance = 0;
+		this->capacity = capacity;
+		this->flow = 0;
+	}
+};
+
+/**
+ * Storage for the paths of a link graph component. Paths are allocated in
+ * blocks and never freed one by one. Instead all of them are dropped at once
+ * when they aren't needed anymore.
+ */
+class PathArena {
+public:
+	PathArena() : used(0) {}
+
+	/**
+	 * Create an empty arena. The paths of a component are never copied.
+	 * @param other Arena not to be copied.
+	 */
+	PathArena(const PathArena &other) : used(0) {}
+
+	/**
+	 * Free all memory on destruction.
+	 */
+	~PathArena() { this->Free(); }
+
+	Path *Allocate();
+
+	/**
+	 * Drop all paths, but keep the memory for reuse. The paths must not be
+	 * used anymore after this.
+	 */
+	inline void Reset() { this->used = 0; }
+
+	void Free();
+
+	size_t GetMemoryUsage() const;
+
+private:
+	static const uint BLOCK_SIZE = 1024; ///< Number of paths in each block.
+
+	std::vector<Path *> blocks; ///< Blocks of uninitialized memory for BLOCK_SIZE paths each.
+	uint used;                  ///< Number of paths handed out since the last reset.
 };
 
 /**
@@ -79,27 +141,28 @@ public:
  * connected by links as nodes and edges. Each component also holds a copy of
  * the link graph settings at the time of its creation. The global settings
  * might change between the creation and join time so we can't rely on them.
+ *
+ * The edges are kept in compressed sparse row format: All edges are stored in
+ * one vector, sorted by source and destination node, and first_edge holds the
+ * position of the first edge of each source node. Like that the memory used
+ * by a component grows with the number of links, not with the square of the
+ * number of nodes.
  */
 class LinkGraphComponent {
-private:
+protected:
 	typedef std::vector<Node> NodeVector;
-	typedef std::vector<std::vector<Edge> > EdgeMatrix;
+	typedef std::vector<Edge> EdgeVector;
 
 public:
+	typedef EdgeVector::iterator EdgeIterator;
+
 	LinkGraphComponent();
 
+	LinkGraphComponent(const LinkGraphSettings &settings, CargoID cargo, LinkGraphComponentID id);
+
 	void Init(LinkGraphComponentID id);
 
-	/**
-	 * Get a reference to an edge.
-	 * @param from Origin node.
-	 * @param to Destination node.
-	 * @return Edge between from and to.
-	 */
-	inline Edge &GetEdge(NodeID from, NodeID to)
-	{
-		return this->edges[from][to];
-	}
+	Edge &GetEdge(NodeID from, NodeID to);
 
 	/**
 	 * Get a reference to a node with the specified id.
@@ -124,8 +187,14 @@ public:
 
 	NodeID AddNode(Station *st);
 
+	NodeID AddNode(StationID st, uint supply, uint demand, TileIndex xy);
+
 	void AddEdge(NodeID from, NodeID to, uint capacity);
 
+	void CompressEdges();
+
+	size_t GetMemoryUsage();
+
 	/**
 	 * Get the ID of this component.
 	 * @return ID.
@@ -154,27 +223,65 @@ public:
 	}
 
 	/**
-	 * Get the first valid edge starting at the specified node.
-	 * @param from ID of the source node
-	 * @return ID of the destination node
+	 * Get the first edge starting at the specified node.
+	 * @param from ID of the source node.
+	 * @return Iterator pointing to the first edge.
+	 */
+	inline EdgeIterator GetFirstEdge(NodeID from)
+	{
+		return this->edges.begin() + this->first_edge[from];
+	}
+
+	/**
+	 * Get the end of the edges starting at the specified node.
+	 * @param from ID of the source node.
+	 * @return Iterator pointing behind the last edge.
+	 */
+	inline EdgeIterator GetEdgesEnd(NodeID from)
+	{
+		return this->edges.begin() + this->first_edge[from + 1];
+	}
+
+	/**
+	 * Get the number of edges starting at the specified node.
+	 * @param from ID of the source node.
+	 * @return Number of edges.
+	 */
+	inline uint GetNumEdges(NodeID from) const
+	{
+		return this->first_edge[from + 1] - this->first_edge[from];
+	}
+
+	/**
+	 * Get the storage for the paths of this component.
+	 * @return Path arena.
 	 */
-	inline NodeID GetFirstEdge(NodeID from) {return edges[from][from].next_edge;}
+	inline PathArena &GetPathArena()
+	{
+		return this->path_arena;
+	}
 
 	/**
-	 * Set the number of nodes to 0 to mark this component as done.
+	 * Set the number of nodes to 0 to mark this component as done and drop
+	 * the edges and paths.
 	 */
 	inline void Clear()
 	{
 		this->num_nodes = 0;
+		this->edges.clear();
+		this->first_edge.clear();
+		this->path_arena.Free();
 	}
 
 protected:
-	LinkGraphSettings settings; ///< Copy of _settings_game.linkgraph at creation time.
-	CargoID cargo;              ///< Cargo of this component's link graph.
-	uint num_nodes;             ///< Number of nodes in the component.
-	LinkGraphComponentID index; ///< ID of the component.
-	NodeVector nodes;           ///< Nodes in the component.
-	EdgeMatrix edges;           ///< Edges in the component.
+	LinkGraphSettings settings;   ///< Copy of _settings_game.linkgraph at creation time.
+	CargoID cargo;                ///< Cargo of this component's link graph.
+	uint num_nodes;               ///< Number of nodes in the component.
+	LinkGraphComponentID index;   ///< ID of the component.
+	NodeVector nodes;             ///< Nodes in the component.
+	EdgeVector edges;             ///< Edges in the component, sorted by source and destination.
+	std::vector<uint> first_edge; ///< Position of each node's first edge in edges, plus one entry marking the end.
+	PathArena path_arena;         ///< Storage for the paths created by the handlers.
 };
 
 /**
@@ -194,12 +301,44 @@ public:
 	 * @param component Link graph component to run the handler on.
 	 */
 	virtual void Run(LinkGraphComponent *component) = 0;
+
+	/**
+	 * Get a short name of the handler for statistics.
+	 * @return Name of the handler.
+	 */
+	virtual const char *GetName() const = 0;
+
+	/**
+	 * Check if the handler can be run on the condensed component and the
+	 * clusters of a decomposed component instead of the component itself.
+	 * Such handlers must only depend on the nodes' demands and the edges.
+	 * @return If the handler can be run on clusters.
+	 */
+	virtual bool RunsOnClusters() const { return false; }
+};
+
+/**
+ * Measurements of a link graph job, taken while it runs and when it's joined.
+ */
+struct LinkGraphJobStats {
+	static const uint MAX_HANDLERS = 8; ///< Maximum number of handlers that can be measured.
+
+	Date join_date;                      ///< Date when the job was joined.
+	LinkGraphComponentID component;      ///< ID of the job's component.
+	uint nodes;                          ///< Number of nodes in the component.
+	uint edges;                          ///< Number of edges in the component.
+	uint num_handlers;                   ///< Number of handlers run on the component.
+	uint64 handler_cycles[MAX_HANDLERS]; ///< CPU ticks spent in each handler.
+	uint64 join_cycles;                  ///< CPU ticks the game waited for the job when joining it.
+	bool join_blocked;                   ///< If the job wasn't finished when it was joined.
+	size_t peak_memory;                  ///< Highest estimated memory used by the component between two handlers.
 };
 
 /**
  * A job to be executed on a link graph component. It inherits a component and
- * keeps a static list of handlers to be run on it. It may or may not run in a
- * thread and contains a thread object for this option.
+ * keeps a static list of handlers to be run on it. The jobs of all cargos are
+ * run by a shared pool of worker threads, so that they can be calculated
+ * concurrently without creating a new thread for each component.
  */
 class LinkGraphJob : public LinkGraphComponent {
 private:
@@ -207,10 +346,10 @@ private:
 
 public:
 
-	LinkGraphJob() : thread(NULL) {}
+	LinkGraphJob() {}
 
 	/**
-	 * Destructor; Clean up the thread if it's there.
+	 * Destructor; Wait for the job if it's still running.
 	 */
 	~LinkGraphJob()
 	{
@@ -225,18 +364,37 @@ public:
 	 */
 	static void AddHandler(ComponentHandler *handler)
 	{
+		assert(LinkGraphJob::_handlers.size() < LinkGraphJobStats::MAX_HANDLERS);
 		LinkGraphJob::_handlers.push_back(handler);
 	}
 
+	static const char *GetHandlerName(uint index);
+
 	static void ClearHandlers();
 
-	void SpawnThread();
+	void Spawn();
 
 	void Join();
 
+	/**
+	 * Check if the job is finished, without waiting for it.
+	 * @return If the job is finished or not running at all.
+	 */
+	inline bool IsFinished() { return LinkGraphJob::_thread_pool.IsDone(&this->task); }
+
+	/**
+	 * Get the thread pool running the link graph jobs.
+	 * @return Thread pool.
+	 */
+	static inline ThreadPool &GetThreadPool() { return LinkGraphJob::_thread_pool; }
+
+protected:
+	LinkGraphJobStats stats;        ///< Measurements of the running job.
+
 private:
 	static HandlerList _handlers;   ///< Handlers the job is executing.
-	ThreadObject *thread;           ///< Thread the job is running in or NULL if it's running in the main thread.
+	static ThreadPool _thread_pool; ///< Worker threads running the jobs of all link graphs.
+	ThreadPoolTask task;            ///< Entry in the thread pool's queue.
 
 	/**
 	 * Private Copy-Constructor: there cannot be two identical LinkGraphJobs.
@@ -247,10 +405,19 @@ private:
 };
 
 /**
- * A link graph, inheriting one job.
+ * A link graph, inheriting one job. Each job is given a join date when it's
+ * spawned, estimated from the size of its component. As the estimate only
+ * depends on the component and the settings, all clients join the job on the
+ * same tick; if the estimate is generous enough the main thread never has to
+ * wait for the job.
  */
 class LinkGraph : public LinkGraphJob {
 public:
+	typedef std::map<StationID, uint64> SignatureMap;
+	typedef std::deque<LinkGraphJobStats> StatsHistory;
+
+	static const uint STATS_HISTORY_LENGTH = 16; ///< Number of jobs whose measurements are kept.
+
 	/* Those are ticks where not much else is happening, so a small lag might go unnoticed. */
 	static const uint COMPONENTS_JOIN_TICK  = 21; ///< Tick when jobs are joined every day.
 	static const uint COMPONENTS_SPAWN_TICK = 58; ///< Tick when jobs are spawned every day.
@@ -258,7 +425,7 @@ public:
 	/**
 	 * Create a link graph.
 	 */
-	LinkGraph() : current_station_id(0) {}
+	LinkGraph() : current_station_id(0), join_date(0) {}
 
 	void Init(CargoID cargo);
 
@@ -266,12 +433,59 @@ public:
 
 	void Join();
 
+	/**
+	 * Check if the running job is due to be joined.
+	 * @return If there is a job and its join date has been reached.
+	 */
+	inline bool IsJoinDue() const
+	{
+		return this->GetSize() > 0 && this->join_date <= _date;
+	}
+
+	/**
+	 * Get the date when the running job will be joined.
+	 * @return Join date.
+	 */
+	inline Date GetJoinDate() const { return this->join_date; }
+
+	uint EstimateDuration() const;
+
+	/**
+	 * Reset the join date of the running job to the given number of days from
+	 * now. Used when loading games that didn't save the join date.
+	 * @param days Days until the job is joined.
+	 */
+	inline void SetJoinDate(uint days) { this->join_date = _date + days; }
+
+	/**
+	 * Get the signatures of the components calculated before. Used for saving
+	 * and loading.
+	 * @return Signatures indexed by the components' first stations.
+	 */
+	inline SignatureMap &GetSignatures() { return this->signatures; }
+
+	/**
+	 * Forget the components calculated before, so that all of them are
+	 * recalculated on their next turn.
+	 */
+	inline void ClearSignatures() { this->signatures.clear(); }
+
+	/**
+	 * Get the measurements of the last jobs that were joined, oldest first.
+	 * @return Job measurements.
+	 */
+	inline const StatsHistory &GetStatsHistory() const { return this->stats_history; }
+
 private:
 	StationID current_station_id; ///< ID of the last station examined while creating components.
+	Date join_date;               ///< Date when the running job is joined.
+	SignatureMap signatures;      ///< Signatures of the last calculation of each component, indexed by its first station.
+	StatsHistory stats_history;   ///< Measurements of the last STATS_HISTORY_LENGTH jobs.
 
 	friend const SaveLoad *GetLinkGraphDesc();
 
 	void CreateComponent(Station *first);
+	uint64 CalculateSignature() const;
 };
 
 /**
@@ -340,6 +554,7 @@ protected:
 	NodeID origin;     ///< Link graph node this path originates from.
 	uint num_children; ///< Number of child legs that have been forked from this path.
 	Path *parent;      ///< Parent leg of this one.
+	bool listed;       ///< If this leg has been added to the paths of its parent's node.
 };
 
 void InitializeLinkGraphs();
@@ -3,6 +3,7 @@
 #include "../stdafx.h"
 #include "../core/math_func.hpp"
 #include "mcf.h"
+#include <new>
 
 /**
  * Determines if an extension to the given Path with the given parameters is
@@ -65,6 +66,43 @@ bool CapacityAnnotation::IsBetter(const CapacityAnnotation *base, uint cap,
 	}
 }
 
+/* Annotations are constructed in memory allocated for plain paths. */
+assert_compile(sizeof(DistanceAnnotation) == sizeof(Path));
+assert_compile(sizeof(CapacityAnnotation) == sizeof(Path));
+
+/**
+ * Make sure the search space holds enough memory for the annotations of one
+ * run of Dijkstra, allocating it from the component's path arena if needed.
+ * The arena isn't thread safe, so this has to be called from the job's
+ * thread before the search is started.
+ * @param space Search space to be prepared.
+ */
+void MultiCommodityFlow::PrepareSearchSpace(SearchSpace &space)
+{
+	PathArena &arena = this->graph->GetPathArena();
+	while (space.spare_paths.size() < this->graph->GetSize()) {
+		space.spare_paths.push_back(arena.Allocate());
+	}
+}
+
+/**
+ * Construct an annotation for a node in memory left over from earlier calls
+ * to Dijkstra or allocated by PrepareSearchSpace.
+ * @tparam Tannotation Annotation to be created.
+ * @param space Search space holding the memory for annotations.
+ * @param node Node the annotation refers to.
+ * @param source If the node is the source of the search.
+ * @return Fresh annotation.
+ */
+template<class Tannotation>
+/* static */ Tannotation *MultiCommodityFlow::NewAnnotation(SearchSpace &space, NodeID node, bool source)
+{
+	assert(!space.spare_paths.empty());
+	Path *memory = space.spare_paths.back();
+	space.spare_paths.pop_back();
+	return new (memory) Tannotation(node, source);
+}
+
 /**
  * A slightly modified Dijkstra algorithm. Grades the paths not necessarily by
  * distance, but by the value Tannotation computes. It can also be configured
@@ -77,29 +115,29 @@ bool CapacityAnnotation::IsBetter(const CapacityAnnotation *base, uint cap,
  * @param paths Container for the paths to be calculated.
  * @param create_new_paths If false, only use paths already seen before,
  *                         otherwise artificially limit the capacity.
+ * @param space Memory to be used for the search.
  */
 template<class Tannotation>
 void MultiCommodityFlow::Dijkstra(NodeID source_node, PathVector &paths,
-		bool create_new_paths)
+		bool create_new_paths, SearchSpace &space)
 {
-	typedef std::set<Tannotation *, typename Tannotation::Comparator> AnnoSet;
 	uint size = this->graph->GetSize();
 	StationID source_station = this->graph->GetNode(source_node).station;
-	AnnoSet annos;
+	AnnotationHeap<Tannotation> annos(space.heap, space.heap_positions, size);
 	paths.resize(size, NULL);
 	for (NodeID node = 0; node < size; ++node) {
-		Tannotation *anno = new Tannotation(node, node == source_node);
-		annos.insert(anno);
+		Tannotation *anno = NewAnnotation<Tannotation>(space, node, node == source_node);
+		annos.Append(anno);
 		paths[node] = anno;
 	}
-	while (!annos.empty()) {
-		typename AnnoSet::iterator i = annos.begin();
-		Tannotation *source = *i;
-		annos.erase(i);
+	annos.Heapify();
+	while (!annos.IsEmpty()) {
+		Tannotation *source = annos.Pop();
 		NodeID from = source->GetNode();
-		NodeID to = this->graph->GetFirstEdge(from);
-		while (to != INVALID_NODE) {
-			Edge &edge = this->graph->GetEdge(from, to);
+		LinkGraphComponent::EdgeIterator end = this->graph->GetEdgesEnd(from);
+		for (LinkGraphComponent::EdgeIterator i = this->graph->GetFirstEdge(from); i != end; ++i) {
+			Edge &edge = *i;
+			NodeID to = edge.to;
 			assert(edge.distance < UINT_MAX);
 			if (create_new_paths || this->graph->GetNode(from)
 					.flows[source_station][this->graph->GetNode(to).station] > 0) {
@@ -113,22 +151,22 @@ void MultiCommodityFlow::Dijkstra(NodeID source_node, PathVector &paths,
 				uint distance = edge.distance + 1;
 				Tannotation *dest = static_cast<Tannotation *>(paths[to]);
 				if (dest->IsBetter(source, capacity, capacity - edge.flow, distance)) {
-					annos.erase(dest);
 					dest->Fork(source, capacity, capacity - edge.flow, distance);
-					annos.insert(dest);
+					annos.Update(dest);
 				}
 			}
-			to = edge.next_edge;
 		}
 	}
 }
 
 /**
- * Clean up paths that lead nowhere and the root path.
+ * Clean up paths that lead nowhere and the root path. They are kept for reuse
+ * in later calls to Dijkstra.
  * @param source_id ID of the root node.
  * @param paths Paths to be cleaned up.
+ * @param space Search space to keep the paths in.
  */
-void MultiCommodityFlow::CleanupPaths(NodeID source_id, PathVector &paths)
+void MultiCommodityFlow::CleanupPaths(NodeID source_id, PathVector &paths, SearchSpace &space)
 {
 	Path *source = paths[source_id];
 	paths[source_id] = NULL;
@@ -141,31 +179,31 @@ void MultiCommodityFlow::CleanupPaths(NodeID source_id, PathVector &paths)
 			path->Detach();
 			if (path->GetNumChildren() == 0) {
 				paths[path->GetNode()] = NULL;
-				delete path;
+				space.spare_paths.push_back(path);
 			}
 			path = parent;
 		}
 	}
-	delete source;
+	space.spare_paths.push_back(source);
 	paths.clear();
 }
 
 /**
  * Push flow along a path and update the unsatisfied_demand of the associated
- * edge.
- * @param edge Edge whose ends the path connects.
+ * demand.
+ * @param demand Demand between the nodes the path connects.
  * @param path End of the path the flow should be pushed on.
  * @param accuracy Accuracy of the calculation.
  * @param positive_cap If true only push flow up to the paths capacity,
  *                     otherwise the path can be "overloaded".
  */
-uint MultiCommodityFlow::PushFlow(Edge &edge, Path *path, uint accuracy,
+uint MultiCommodityFlow::PushFlow(Demand &demand, Path *path, uint accuracy,
 		bool positive_cap)
 {
-	assert(edge.unsatisfied_demand > 0);
-	uint flow = Clamp(edge.demand / accuracy, 1, edge.unsatisfied_demand);
+	assert(demand.unsatisfied_demand > 0);
+	uint flow = Clamp(demand.demand / accuracy, 1, demand.unsatisfied_demand);
 	flow = path->AddFlow(flow, this->graph, positive_cap);
-	edge.unsatisfied_demand -= flow;
+	demand.unsatisfied_demand -= flow;
 	return flow;
 }
 
@@ -224,9 +262,9 @@ bool MCF1stPass::EliminateCycles(PathVector &path, NodeID origin_id, NodeID next
 		/* summarize paths; add up the paths with the same source and next hop
 		 * in one path each
 		 */
-		PathSet &paths = this->graph->GetNode(next_id).paths;
+		PathList &paths = this->graph->GetNode(next_id).paths;
 		PathViaMap next_hops;
-		for (PathSet::iterator i = paths.begin(); i != paths.end(); ++i) {
+		for (PathList::iterator i = paths.begin(); i != paths.end(); ++i) {
 			Path *new_child = *i;
 			if (new_child->GetOrigin() == origin_id) {
 				PathViaMap::iterator via_it = next_hops.find(new_child->GetNode());
@@ -295,47 +333,94 @@ bool MCF1stPass::EliminateCycles()
 }
 
 /**
- * Run the first pass of the MCF calculation.
+ * Search the shortest paths for one source.
+ * @param search PathSearch to be run.
+ */
+/* static */ void MCF1stPass::RunPathSearch(void *search)
+{
+	PathSearch *s = static_cast<PathSearch *>(search);
+	s->pass->Dijkstra<DistanceAnnotation>(s->source, s->paths, true, s->space);
+}
+
+/**
+ * Search the shortest paths for a batch of consecutive sources. The searches
+ * only read the component, so they can run in the link graph thread pool at
+ * the same time. The first one is run in the current thread.
+ * @param first First source of the batch.
+ * @param count Number of sources in the batch.
+ */
+void MCF1stPass::SearchPaths(NodeID first, uint count)
+{
+	assert(count > 0 && count <= SEARCH_BATCH_SIZE);
+	ThreadPool &pool = LinkGraphJob::GetThreadPool();
+	for (uint i = 0; i < count; ++i) {
+		PathSearch &search = this->searches[i];
+		search.pass = this;
+		search.source = first + i;
+		this->PrepareSearchSpace(search.space);
+		if (i > 0) pool.Start(&search.task, &MCF1stPass::RunPathSearch, &search);
+	}
+	RunPathSearch(&this->searches[0]);
+	for (uint i = 1; i < count; ++i) pool.Wait(&this->searches[i].task);
+}
+
+const char * const MCF1stPass::NAME = "mcf 1st pass";
+const char * const MCF2ndPass::NAME = "mcf 2nd pass";
+
+/**
+ * Run the first pass of the MCF calculation. In big components the paths for
+ * a batch of sources are searched at the same time and the flows are assigned
+ * afterwards, in order of the sources.
  * @param graph Component to calculate.
  */
 MCF1stPass::MCF1stPass(LinkGraphComponent *graph) : MultiCommodityFlow(graph)
 {
-	PathVector paths;
 	uint size = this->graph->GetSize();
 	uint accuracy = this->graph->GetSettings().accuracy;
+	uint max_rounds = this->graph->GetSettings().max_mcf_rounds;
+	uint batch_size = size < MIN_BATCH_COMPONENT_SIZE ? 1 : SEARCH_BATCH_SIZE;
 	bool more_loops = true;
 
-	while (more_loops) {
+	for (uint round = 1; more_loops; ++round) {
 		more_loops = false;
 
-		for (NodeID source = 0; source < size; ++source) {
+		for (NodeID first = 0; first < size; first += batch_size) {
+			uint count = min(batch_size, size - first);
 			/* first saturate the shortest paths */
-			this->Dijkstra<DistanceAnnotation>(source, paths, true);
+			this->SearchPaths(first, count);
 
-			for (NodeID dest = 0; dest < size; ++dest) {
-				Edge &edge = this->graph->GetEdge(source, dest);
-				if (edge.unsatisfied_demand > 0) {
-					Path *path = paths[dest];
-					assert(path != NULL);
-					/* generally only allow paths that don't exceed the
-					 * available capacity. But if no demand has been assigned
-					 * yet, make an exception and allow any valid path *once*.
-					 */
-					if (path->GetFreeCapacity() > 0 && this->PushFlow(edge, path,
-							accuracy, true) > 0) {
-						/* if a path has been found there is a chance we can
-						 * find more
+			for (uint batch_index = 0; batch_index < count; ++batch_index) {
+				NodeID source = first + batch_index;
+				PathVector &paths = this->searches[batch_index].paths;
+				DemandMap &demands = this->graph->GetNode(source).demands;
+				for (DemandMap::iterator i = demands.begin(); i != demands.end(); ++i) {
+					Demand &demand = i->second;
+					if (demand.unsatisfied_demand > 0) {
+						Path *path = paths[i->first];
+						assert(path != NULL);
+						/* generally only allow paths that don't exceed the
+						 * available capacity. But if no demand has been assigned
+						 * yet, make an exception and allow any valid path *once*.
 						 */
-						more_loops = (edge.unsatisfied_demand > 0);
-					} else if (edge.unsatisfied_demand == edge.demand &&
-							path->GetFreeCapacity() > INT_MIN) {
-						this->PushFlow(edge, path, accuracy, false);
+						if (path->GetFreeCapacity() > 0 && this->PushFlow(demand, path,
+								accuracy, true) > 0) {
+							/* if a path has been found there is a chance we can
+							 * find more
+							 */
+							more_loops = (demand.unsatisfied_demand > 0);
+						} else if (demand.unsatisfied_demand == demand.demand &&
+								path->GetFreeCapacity() > INT_MIN) {
+							this->PushFlow(demand, path, accuracy, false);
+						}
 					}
 				}
+				this->CleanupPaths(source, paths, this->searches[batch_index].space);
 			}
-			this->CleanupPaths(source, paths);
 		}
-		if (!more_loops) more_loops = this->EliminateCycles();
+		/* In the last round eliminate the cycles even if there is flow left
+		 * to be assigned and leave that flow to the second pass. */
+		bool last_round = (round == max_rounds);
+		if (!more_loops || last_round) more_loops = this->EliminateCycles() && !last_round;
 	}
 }
 
@@ -349,20 +434,25 @@ MCF2ndPass::MCF2ndPass(LinkGraphComponent *graph) : MultiCommodityFlow(graph)
 	PathVector paths;
 	uint size = this->graph->GetSize();
 	uint accuracy = this->graph->GetSettings().accuracy;
+	uint max_rounds = this->graph->GetSettings().max_mcf_rounds;
 	bool demand_left = true;
-	while (demand_left) {
+	for (uint round = 1; demand_left; ++round) {
 		demand_left = false;
+		/* Assign all remaining demand in the last round. */
+		if (round == max_rounds) accuracy = 1;
 		for (NodeID source = 0; source < size; ++source) {
-			this->Dijkstra<CapacityAnnotation>(source, paths, false);
-			for (NodeID dest = 0; dest < size; ++dest) {
-				Edge &edge = this->graph->GetEdge(source, dest);
-				Path *path = paths[dest];
-				if (edge.unsatisfied_demand > 0 && path->GetFreeCapacity() > INT_MIN) {
-					this->PushFlow(edge, path, accuracy, false);
-					if (edge.unsatisfied_demand > 0) demand_left = true;
+			this->PrepareSearchSpace(this->space);
+			this->Dijkstra<CapacityAnnotation>(source, paths, false, this->space);
+			DemandMap &demands = this->graph->GetNode(source).demands;
+			for (DemandMap::iterator i = demands.begin(); i != demands.end(); ++i) {
+				Demand &demand = i->second;
+				Path *path = paths[i->first];
+				if (demand.unsatisfied_demand > 0 && path->GetFreeCapacity() > INT_MIN) {
+					this->PushFlow(demand, path, accuracy, false);
+					if (demand.unsatisfied_demand > 0) demand_left = true;
 				}
 			}
-			this->CleanupPaths(source, paths);
+			this->CleanupPaths(source, paths, this->space);
 		}
 	}
 }
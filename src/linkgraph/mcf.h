@@ -55,21 +55,194 @@ public:
 
 
 typedef std::vector<Path *> PathVector;
+typedef std::vector<uint> HeapPositionVector;
+
+/**
+ * Indexed d-ary heap of annotations for the Dijkstra algorithm. The position
+ * of each node's annotation in the heap is kept in a flat array indexed by
+ * node, so that an annotation can be moved up or down when its value changes
+ * instead of being removed and reinserted. The storage is passed in by the
+ * caller so that it can be reused across calls.
+ * @tparam Tannotation Annotation type; its Comparator determines the order.
+ */
+template<class Tannotation>
+class AnnotationHeap {
+public:
+	static const uint ARITY = 4;              ///< Number of children of each heap entry.
+	static const uint NOT_IN_HEAP = UINT_MAX; ///< Position of nodes that aren't in the heap.
+
+	/**
+	 * Create an empty heap on the given storage.
+	 * @param items Storage for the heap entries.
+	 * @param positions Storage for the positions of the nodes in the heap.
+	 * @param size Number of nodes in the graph.
+	 */
+	AnnotationHeap(PathVector &items, HeapPositionVector &positions, uint size) :
+		items(items), positions(positions)
+	{
+		this->items.clear();
+		this->positions.assign(size, NOT_IN_HEAP);
+	}
+
+	/**
+	 * Check if the heap is empty.
+	 * @return If there are no more annotations in the heap.
+	 */
+	inline bool IsEmpty() const { return this->items.empty(); }
+
+	/**
+	 * Add an annotation without restoring the heap order. Heapify has to be
+	 * called before the heap is used.
+	 * @param anno Annotation to be added.
+	 */
+	inline void Append(Tannotation *anno)
+	{
+		assert(this->positions[anno->GetNode()] == NOT_IN_HEAP);
+		this->items.push_back(anno);
+		this->positions[anno->GetNode()] = (uint)this->items.size() - 1;
+	}
+
+	/**
+	 * Restore the heap order after annotations have been appended.
+	 */
+	void Heapify()
+	{
+		for (uint pos = (uint)this->items.size() / ARITY + 1; pos > 0; --pos) {
+			this->SiftDown(pos - 1);
+		}
+	}
+
+	/**
+	 * Insert an annotation or move it to its new position after its value has
+	 * changed.
+	 * @param anno Annotation to be updated.
+	 */
+	void Update(Tannotation *anno)
+	{
+		uint pos = this->positions[anno->GetNode()];
+		if (pos == NOT_IN_HEAP) {
+			this->items.push_back(anno);
+			this->SiftUp((uint)this->items.size() - 1);
+		} else {
+			this->SiftUp(pos);
+			this->SiftDown(this->positions[anno->GetNode()]);
+		}
+	}
+
+	/**
+	 * Remove the best annotation from the heap.
+	 * @return Best annotation.
+	 */
+	Tannotation *Pop()
+	{
+		Tannotation *best = static_cast<Tannotation *>(this->items.front());
+		this->positions[best->GetNode()] = NOT_IN_HEAP;
+		Path *last = this->items.back();
+		this->items.pop_back();
+		if (!this->items.empty()) {
+			this->Place(0, last);
+			this->SiftDown(0);
+		}
+		return best;
+	}
+
+private:
+	PathVector &items;                    ///< Heap entries.
+	HeapPositionVector &positions;        ///< Position of each node's annotation in items.
+	typename Tannotation::Comparator comp; ///< Order of the annotations.
+
+	/**
+	 * Check if the entry at one position has to be popped before another one.
+	 * @param a First position.
+	 * @param b Second position.
+	 * @return If a is better than b.
+	 */
+	inline bool Before(uint a, uint b) const
+	{
+		return this->comp(static_cast<Tannotation *>(this->items[a]), static_cast<Tannotation *>(this->items[b]));
+	}
+
+	/**
+	 * Put an annotation at a position in the heap and record the position.
+	 * @param pos Position.
+	 * @param anno Annotation.
+	 */
+	inline void Place(uint pos, Path *anno)
+	{
+		this->items[pos] = anno;
+		this->positions[anno->GetNode()] = pos;
+	}
+
+	/**
+	 * Move the entry at the given position up until its parent is better.
+	 * @param pos Position of the entry.
+	 */
+	void SiftUp(uint pos)
+	{
+		Path *anno = this->items[pos];
+		while (pos > 0) {
+			uint parent = (pos - 1) / ARITY;
+			if (!this->comp(static_cast<Tannotation *>(anno), static_cast<Tannotation *>(this->items[parent]))) break;
+			this->Place(pos, this->items[parent]);
+			pos = parent;
+		}
+		this->Place(pos, anno);
+	}
+
+	/**
+	 * Move the entry at the given position down until all its children are worse.
+	 * @param pos Position of the entry.
+	 */
+	void SiftDown(uint pos)
+	{
+		uint size = (uint)this->items.size();
+		if (pos >= size) return;
+		Path *anno = this->items[pos];
+		for (;;) {
+			uint first = pos * ARITY + 1;
+			if (first >= size) break;
+			uint best = first;
+			uint last = min(first + ARITY, size);
+			for (uint child = first + 1; child < last; ++child) {
+				if (this->Before(child, best)) best = child;
+			}
+			if (!this->comp(static_cast<Tannotation *>(this->items[best]), static_cast<Tannotation *>(anno))) break;
+			this->Place(pos, this->items[best]);
+			pos = best;
+		}
+		this->Place(pos, anno);
+	}
+};
 
 /**
  * Multi-commodity flow calculating base class.
  */
 class MultiCommodityFlow {
 protected:
+	/**
+	 * Memory used by runs of the Dijkstra algorithm, kept for reuse by later
+	 * runs. Runs executed at the same time need separate search spaces.
+	 */
+	struct SearchSpace {
+		PathVector heap;                   ///< Storage for the Dijkstra heap.
+		HeapPositionVector heap_positions; ///< Positions of the nodes in the Dijkstra heap.
+		PathVector spare_paths;            ///< Memory for annotations, from the path arena or left over from previous runs.
+	};
+
 	MultiCommodityFlow(LinkGraphComponent *graph) : graph(graph) {}
 
-	template<class ANNOTATION> void Dijkstra(NodeID from, PathVector &paths, bool create_new_paths);
+	void PrepareSearchSpace(SearchSpace &space);
+
+	template<class Tannotation> static Tannotation *NewAnnotation(SearchSpace &space, NodeID node, bool source);
 
-	uint PushFlow(Edge &edge, Path *path, uint accuracy, bool positive_cap);
+	template<class Tannotation> void Dijkstra(NodeID from, PathVector &paths, bool create_new_paths, SearchSpace &space);
 
-	void CleanupPaths(NodeID source, PathVector &paths);
+	uint PushFlow(Demand &demand, Path *path, uint accuracy, bool positive_cap);
+
+	void CleanupPaths(NodeID source, PathVector &paths, SearchSpace &space);
 
 	LinkGraphComponent *graph; ///< Component we're working with.
+	SearchSpace space;         ///< Search space for runs of Dijkstra in the job's own thread.
 };
 
 /**
@@ -86,14 +259,44 @@ protected:
  *   time it will take.
  * - You can increase the recalculation interval to allow for longer running
  *   times without creating lags.
+ * - The max_mcf_rounds setting limits the number of rounds of flow assignment.
+ *   Cycles are still eliminated in the last round, but flow which isn't
+ *   assigned by then is left to the second pass.
  */
 class MCF1stPass : public MultiCommodityFlow {
 private:
+	/**
+	 * Number of sources whose paths are searched at the same time in big
+	 * components. The flows for a batch are assigned after all its searches
+	 * are done, so this influences the result and must not depend on the
+	 * machine the calculation runs on.
+	 */
+	static const uint SEARCH_BATCH_SIZE = 16;
+
+	/** Minimum size of components whose paths are searched in batches. */
+	static const uint MIN_BATCH_COMPONENT_SIZE = 64;
+
+	/** A search for the paths from one source, possibly running in another thread. */
+	struct PathSearch {
+		MCF1stPass *pass;   ///< Pass the search belongs to.
+		NodeID source;      ///< Source node of the search.
+		PathVector paths;   ///< Paths found.
+		SearchSpace space;  ///< Memory for the search.
+		ThreadPoolTask task; ///< Task running the search.
+	};
+
+	PathSearch searches[SEARCH_BATCH_SIZE]; ///< Searches of the current batch.
+
+	void SearchPaths(NodeID first, uint count);
+	static void RunPathSearch(void *search);
+
 	bool EliminateCycles();
 	bool EliminateCycles(PathVector &path, NodeID origin_id, NodeID next_id);
 	void EliminateCycle(PathVector &path, Path *cycle_begin, uint flow);
 	uint FindCycleFlow(const PathVector &path, const Path *cycle_begin);
 public:
+	static const char * const NAME; ///< Name of the pass for statistics.
+
 	MCF1stPass(LinkGraphComponent *graph);
 };
 
@@ -102,10 +305,14 @@ public:
  * first and doesn't create any paths along edges that haven't been visited in
  * the first pass. This is why it doesn't have to do any cycle detection and
  * elimination. As cycle detection is the most intense problem in the first
- * pass this pass is cheaper. The accuracy is used here, too.
+ * pass this pass is cheaper. The accuracy is used here, too. If the number of
+ * rounds is limited by the max_mcf_rounds setting, all remaining demand is
+ * assigned to the most capacious paths in the last round.
  */
 class MCF2ndPass : public MultiCommodityFlow {
 public:
+	static const char * const NAME; ///< Name of the pass for statistics.
+
 	MCF2ndPass(LinkGraphComponent *graph);
 };
 
@@ -123,6 +330,18 @@ public:
 	 */
 	virtual void Run(LinkGraphComponent *graph) {Tpass pass(graph);}
 
+	/**
+	 * Get the name of the handler.
+	 * @return Name of the pass.
+	 */
+	virtual const char *GetName() const { return Tpass::NAME; }
+
+	/**
+	 * MCF only needs the demands and the edges.
+	 * @return true.
+	 */
+	virtual bool RunsOnClusters() const { return true; }
+
 	virtual ~MCFHandler() {}
 };
 
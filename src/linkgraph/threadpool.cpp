@@ -0,0 +1,174 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file threadpool.cpp Definition of the thread pool running link graph jobs. */
+
+#include "../stdafx.h"
+#include "../debug.h"
+#include "../core/math_func.hpp"
+#include "threadpool.h"
+#include <algorithm>
+
+/**
+ * Create a thread pool. The workers are only created when the first task is
+ * started.
+ */
+ThreadPool::ThreadPool() : mutex(ThreadMutex::New()), initialized(false), exiting(false) {}
+
+/**
+ * Tell all workers to exit and wait for them. All tasks have to be finished
+ * at this point.
+ */
+ThreadPool::~ThreadPool()
+{
+	this->mutex->BeginCritical();
+	assert(this->queue.empty());
+	this->exiting = true;
+	this->mutex->SendSignal();
+	this->mutex->EndCritical();
+
+	for (WorkerVector::iterator i = this->workers.begin(); i != this->workers.end(); ++i) {
+		(*i)->Join();
+		delete *i;
+	}
+	delete this->mutex;
+}
+
+/**
+ * Create one worker for each processor core. If no threads are available, no
+ * workers are created.
+ */
+void ThreadPool::CreateWorkers()
+{
+	this->initialized = true;
+	uint count = max(GetCPUCoreCount(), 1U);
+	for (uint i = 0; i < count; ++i) {
+		ThreadObject *thread = NULL;
+		if (!ThreadObject::New(&ThreadPool::RunWorker, this, &thread)) break;
+		this->workers.push_back(thread);
+	}
+	DEBUG(misc, 1, "Started %u link graph worker threads", this->GetNumWorkers());
+}
+
+/**
+ * Schedule a task. If there are no workers, the procedure is run right away.
+ * @param task Task to be scheduled. Must not be scheduled already.
+ * @param proc Procedure to be called by the worker.
+ * @param param Parameter for the procedure.
+ */
+void ThreadPool::Start(ThreadPoolTask *task, OTTDThreadFunc proc, void *param)
+{
+	if (!this->initialized) this->CreateWorkers();
+
+	assert(task->done);
+	task->proc = proc;
+	task->param = param;
+
+	if (this->workers.empty()) {
+		/* Of course this will hang a bit. On the other hand, if you want to
+		 * play games which make this hang noticably on a platform without
+		 * threads then you'll probably get other problems first. */
+		proc(param);
+		return;
+	}
+
+	if (task->mutex == NULL) task->mutex = ThreadMutex::New();
+	task->done = false;
+
+	this->mutex->BeginCritical();
+	this->queue.push_back(task);
+	this->mutex->SendSignal();
+	this->mutex->EndCritical();
+}
+
+/**
+ * Wait for a task to finish. Returns immediately if it isn't scheduled. If no
+ * worker has picked up the task yet, it's run in the calling thread. Like that
+ * tasks can wait for other tasks they have started without blocking the pool.
+ * @param task Task to wait for.
+ */
+void ThreadPool::Wait(ThreadPoolTask *task)
+{
+	if (task->mutex == NULL) return;
+
+	this->mutex->BeginCritical();
+	TaskQueue::iterator queued = std::find(this->queue.begin(), this->queue.end(), task);
+	bool run_here = (queued != this->queue.end());
+	if (run_here) this->queue.erase(queued);
+	this->mutex->EndCritical();
+	if (run_here) this->Run(task);
+
+	task->mutex->BeginCritical();
+	while (!task->done) task->mutex->WaitForSignal();
+	task->mutex->EndCritical();
+}
+
+/**
+ * Check if a task has finished, without waiting for it.
+ * @param task Task to be checked.
+ * @return If the task is done or wasn't scheduled at all.
+ */
+bool ThreadPool::IsDone(ThreadPoolTask *task)
+{
+	if (task->mutex == NULL) return true;
+	task->mutex->BeginCritical();
+	bool done = task->done;
+	task->mutex->EndCritical();
+	return done;
+}
+
+/**
+ * Main loop of a worker: Take tasks from the queue and run them until the
+ * pool is destroyed.
+ */
+void ThreadPool::Work()
+{
+	for (;;) {
+		this->mutex->BeginCritical();
+		while (this->queue.empty() && !this->exiting) this->mutex->WaitForSignal();
+		if (this->exiting) {
+			/* Pass the signal on to the next worker. */
+			this->mutex->SendSignal();
+			this->mutex->EndCritical();
+			return;
+		}
+		ThreadPoolTask *task = this->queue.front();
+		this->queue.pop_front();
+		/* Signals might have been merged; wake another worker for the rest. */
+		if (!this->queue.empty()) this->mutex->SendSignal();
+		this->mutex->EndCritical();
+
+		this->Run(task);
+	}
+}
+
+/**
+ * Run a task which has been taken from the queue and mark it as done.
+ * @param task Task to be run.
+ */
+void ThreadPool::Run(ThreadPoolTask *task)
+{
+	task->proc(task->param);
+
+	/* The task may be destroyed as soon as the waiting thread sees it's
+	 * done, so don't touch it after leaving the critical section. */
+	task->mutex->BeginCritical();
+	task->done = true;
+	task->mutex->SendSignal();
+	task->mutex->EndCritical();
+}
+
+/**
+ * Entry point for worker threads.
+ * @param pool Thread pool the worker belongs to.
+ */
+/* static */ void ThreadPool::RunWorker(void *pool)
+{
+	static_cast<ThreadPool *>(pool)->Work();
+}
@@ -0,0 +1,83 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file threadpool.h Declaration of the thread pool running link graph jobs. */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include "../thread/thread.h"
+#include <deque>
+#include <vector>
+
+/**
+ * A piece of work to be run by a thread pool. The task is owned by whoever
+ * schedules it and has to be kept alive until ThreadPool::Wait has returned.
+ */
+class ThreadPoolTask {
+public:
+	ThreadPoolTask() : proc(NULL), param(NULL), mutex(NULL), done(true) {}
+
+	/**
+	 * Destroy the task. It must not be scheduled anymore at that point.
+	 */
+	~ThreadPoolTask() { delete this->mutex; }
+
+private:
+	friend class ThreadPool;
+
+	OTTDThreadFunc proc; ///< Procedure to be called.
+	void *param;         ///< Parameter for the procedure.
+	ThreadMutex *mutex;  ///< Mutex for signalling completion of the task.
+	bool done;           ///< If the procedure has returned.
+
+	/**
+	 * Private copy constructor: Tasks can't be copied while the pool refers to them.
+	 * @param other Hypothetical other task.
+	 */
+	ThreadPoolTask(const ThreadPoolTask &other) {NOT_REACHED();}
+};
+
+/**
+ * A persistent set of worker threads processing a queue of tasks. The workers
+ * are created on first use, one for each processor core. If no threads can be
+ * created the tasks are run right away in the calling thread.
+ */
+class ThreadPool {
+public:
+	ThreadPool();
+	~ThreadPool();
+
+	void Start(ThreadPoolTask *task, OTTDThreadFunc proc, void *param);
+	void Wait(ThreadPoolTask *task);
+	bool IsDone(ThreadPoolTask *task);
+
+	/**
+	 * Get the number of worker threads.
+	 * @return Number of workers; 0 if the tasks are run in the calling thread.
+	 */
+	inline uint GetNumWorkers() const { return (uint)this->workers.size(); }
+
+private:
+	typedef std::deque<ThreadPoolTask *> TaskQueue;
+	typedef std::vector<ThreadObject *> WorkerVector;
+
+	ThreadMutex *mutex;   ///< Mutex protecting the queue and signalling new tasks.
+	TaskQueue queue;      ///< Tasks waiting for a worker.
+	WorkerVector workers; ///< Worker threads.
+	bool initialized;     ///< If the workers have been created.
+	bool exiting;         ///< If the workers should exit.
+
+	void CreateWorkers();
+	void Run(ThreadPoolTask *task);
+	void Work();
+	static void RunWorker(void *pool);
+};
+
+#endif /* THREADPOOL_H_ */
@@ -28,6 +28,7 @@
 #include "window_func.h"
 #include "core/pool_type.hpp"
 #include "game/game.hpp"
+#include "pathfinder/yapf/yapf_cache.h"
 
 
 extern TileIndex _cur_tileloop_tile;
@@ -42,6 +43,7 @@ void InitializeAirportGui();
 void InitializeDockGui();
 void InitializeObjectGui();
 void InitializeIndustries();
+void InitializeCargoPackets();
 void InitializeObjects();
 void InitializeTrees();
 void InitializeCompanies();
@@ -91,8 +93,11 @@ void InitializeGame(uint size_x, uint size_y, bool reset_date, bool reset_settin
 	InitializeIndustries();
 	InitializeObjects();
 	InitializeBuildingCounts();
+	InitializeCargoPackets();
 
 	InitializeNPF();
+	YapfNotifyTrackLayoutChange(INVALID_TILE, INVALID_TRACK);
+	YapfNotifyRoadLayoutChange(INVALID_TILE);
 
 	InitializeCompanies();
 	AI::Initialize();
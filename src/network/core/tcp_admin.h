@@ -60,6 +60,7 @@ enum PacketAdminType {
 	ADMIN_PACKET_SERVER_CMD_NAMES,       ///< The server sends out the names of the DoCommands to the admins.
 	ADMIN_PACKET_SERVER_CMD_LOGGING,     ///< The server gives the admin copies of incoming command packets.
 	ADMIN_PACKET_SERVER_GAMESCRIPT,      ///< The server gives the admin information from the GameScript in JSON.
+	ADMIN_PACKET_SERVER_LINKGRAPH,       ///< The server gives the admin measurements of a link graph job.
 
 	INVALID_ADMIN_PACKET = 0xFF,         ///< An invalid marker for admin packets.
 };
@@ -83,6 +84,7 @@ enum AdminUpdateType {
 	ADMIN_UPDATE_CMD_NAMES,       ///< The admin would like a list of all DoCommand names.
 	ADMIN_UPDATE_CMD_LOGGING,     ///< The admin would like to have DoCommand information.
 	ADMIN_UPDATE_GAMESCRIPT,      ///< The admin would like to have gamescript messages.
+	ADMIN_UPDATE_LINKGRAPH,       ///< The admin would like to have measurements of link graph jobs.
 	ADMIN_UPDATE_END,             ///< Must ALWAYS be on the end of this list!! (period)
 };
 
@@ -148,6 +150,7 @@ protected:
 	 * uint32  ID relevant to the packet type, e.g.
 	 *          - the client ID for #ADMIN_UPDATE_CLIENT_INFO. Use UINT32_MAX to show all clients.
 	 *          - the company ID for #ADMIN_UPDATE_COMPANY_INFO. Use UINT32_MAX to show all companies.
+	 *          - the cargo ID for #ADMIN_UPDATE_LINKGRAPH. Use UINT32_MAX to show all cargos.
 	 * @param p The packet that was just received.
 	 * @return The state the network should have.
 	 */
@@ -454,6 +457,30 @@ protected:
 	 */
 	virtual NetworkRecvStatus Receive_SERVER_CMD_LOGGING(Packet *p);
 
+	/**
+	 * Send the measurements of a link graph job. These are sent whenever a
+	 * job is joined and, when polled, for all jobs the server remembers.
+	 *
+	 * NOTICE: The number and order of the handlers is not stable across
+	 *         different versions / revisions of OpenTTD.
+	 *
+	 * uint8   ID of the cargo.
+	 * uint16  ID of the link graph component.
+	 * uint32  Date the job was joined.
+	 * uint32  Number of nodes in the component.
+	 * uint32  Number of edges in the component.
+	 * uint64  Estimated peak memory used by the component, in bytes.
+	 * bool    Whether the game had to wait for the job when joining it.
+	 * uint64  CPU ticks the game waited for the job.
+	 * uint8   Number of handlers.
+	 * These two fields are repeated for each handler:
+	 * string  Name of the handler.
+	 * uint64  CPU ticks spent in the handler.
+	 * @param p The packet that was just received.
+	 * @return The state the network should have.
+	 */
+	virtual NetworkRecvStatus Receive_SERVER_LINKGRAPH(Packet *p);
+
 	NetworkRecvStatus HandlePacket(Packet *p);
 public:
 	NetworkRecvStatus CloseConnection(bool error = true);
@@ -24,6 +24,7 @@
 #include "../map_func.h"
 #include "../rev.h"
 #include "../game/game.hpp"
+#include "../linkgraph/linkgraph.h"
 
 
 /* This file handles all the admin network commands. */
@@ -54,6 +55,7 @@ static const AdminUpdateFrequency _admin_update_type_frequencies[] = {
 	ADMIN_FREQUENCY_POLL,                                                                                                                                  ///< ADMIN_UPDATE_CMD_NAMES
 	                       ADMIN_FREQUENCY_AUTOMATIC,                                                                                                      ///< ADMIN_UPDATE_CMD_LOGGING
 	                       ADMIN_FREQUENCY_AUTOMATIC,                                                                                                      ///< ADMIN_UPDATE_GAMESCRIPT
+	ADMIN_FREQUENCY_POLL | ADMIN_FREQUENCY_AUTOMATIC,                                                                                                      ///< ADMIN_UPDATE_LINKGRAPH
 };
 /** Sanity check. */
 assert_compile(lengthof(_admin_update_type_frequencies) == ADMIN_UPDATE_END);
@@ -620,6 +622,49 @@ NetworkRecvStatus ServerNetworkAdminSocketHandler::SendCmdLogging(ClientID clien
 	return NETWORK_RECV_STATUS_OKAY;
 }
 
+/**
+ * Send the measurements of a link graph job.
+ * @param cargo The cargo of the job's link graph.
+ * @param stats The measurements of the job.
+ */
+NetworkRecvStatus ServerNetworkAdminSocketHandler::SendLinkGraph(CargoID cargo, const LinkGraphJobStats &stats)
+{
+	Packet *p = new Packet(ADMIN_PACKET_SERVER_LINKGRAPH);
+
+	p->Send_uint8 (cargo);
+	p->Send_uint16(stats.component);
+	p->Send_uint32(stats.join_date);
+	p->Send_uint32(stats.nodes);
+	p->Send_uint32(stats.edges);
+	p->Send_uint64(stats.peak_memory);
+	p->Send_bool  (stats.join_blocked);
+	p->Send_uint64(stats.join_cycles);
+	p->Send_uint8 (stats.num_handlers);
+	for (uint i = 0; i < stats.num_handlers; i++) {
+		const char *name = LinkGraphJob::GetHandlerName(i);
+		p->Send_string(name == NULL ? "" : name);
+		p->Send_uint64(stats.handler_cycles[i]);
+	}
+
+	this->SendPacket(p);
+
+	return NETWORK_RECV_STATUS_OKAY;
+}
+
+/**
+ * Send the measurements of all remembered jobs of a link graph.
+ * @param cargo The cargo of the link graph.
+ */
+NetworkRecvStatus ServerNetworkAdminSocketHandler::SendLinkGraphHistory(CargoID cargo)
+{
+	const LinkGraph::StatsHistory &history = _link_graphs[cargo].GetStatsHistory();
+	for (LinkGraph::StatsHistory::const_iterator i = history.begin(); i != history.end(); ++i) {
+		this->SendLinkGraph(cargo, *i);
+	}
+
+	return NETWORK_RECV_STATUS_OKAY;
+}
+
 /***********
  * Receiving functions
  ************/
@@ -735,6 +780,17 @@ NetworkRecvStatus ServerNetworkAdminSocketHandler::Receive_ADMIN_POLL(Packet *p)
 			this->SendCmdNames();
 			break;
 
+		case ADMIN_UPDATE_LINKGRAPH:
+			/* The admin is requesting the measurements of link graph jobs. */
+			if (d1 == UINT32_MAX) {
+				for (CargoID cargo = 0; cargo < NUM_CARGO; cargo++) {
+					this->SendLinkGraphHistory(cargo);
+				}
+			} else if (d1 < NUM_CARGO) {
+				this->SendLinkGraphHistory((CargoID)d1);
+			}
+			break;
+
 		default:
 			/* An unsupported "poll" update type. */
 			DEBUG(net, 3, "[admin] Not supported poll %d (%d) from '%s' (%s).", type, d1, this->admin_name, this->admin_version);
@@ -961,6 +1017,21 @@ void NetworkAdminCmdLogging(const NetworkClientSocket *owner, const CommandPacke
 	}
 }
 
+/**
+ * Distribute the measurements of a link graph job that has just been joined.
+ * @param cargo The cargo of the job's link graph.
+ * @param stats The measurements of the job.
+ */
+void NetworkAdminLinkGraph(CargoID cargo, const LinkGraphJobStats &stats)
+{
+	ServerNetworkAdminSocketHandler *as;
+	FOR_ALL_ACTIVE_ADMIN_SOCKETS(as) {
+		if (as->update_frequency[ADMIN_UPDATE_LINKGRAPH] & ADMIN_FREQUENCY_AUTOMATIC) {
+			as->SendLinkGraph(cargo, stats);
+		}
+	}
+}
+
 /**
  * Send a Welcome packet to all connected admins
  */
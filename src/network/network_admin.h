@@ -17,6 +17,9 @@
 #include "network_internal.h"
 #include "core/tcp_listen.h"
 #include "core/tcp_admin.h"
+#include "../cargo_type.h"
+
+struct LinkGraphJobStats;
 
 extern AdminIndex _redirect_console_to_admin;
 
@@ -69,6 +72,8 @@ public:
 	NetworkRecvStatus SendGameScript(const char *json);
 	NetworkRecvStatus SendCmdNames();
 	NetworkRecvStatus SendCmdLogging(ClientID client_id, const CommandPacket *cp);
+	NetworkRecvStatus SendLinkGraph(CargoID cargo, const LinkGraphJobStats &stats);
+	NetworkRecvStatus SendLinkGraphHistory(CargoID cargo);
 
 	static void Send();
 	static void AcceptConnection(SOCKET s, const NetworkAddress &address);
@@ -120,6 +125,7 @@ void NetworkServerSendAdminRcon(AdminIndex admin_index, TextColour colour_code,
 void NetworkAdminConsole(const char *origin, const char *string);
 void NetworkAdminGameScript(const char *json);
 void NetworkAdminCmdLogging(const NetworkClientSocket *owner, const CommandPacket *cp);
+void NetworkAdminLinkGraph(CargoID cargo, const LinkGraphJobStats &stats);
 
 #endif /* ENABLE_NETWORK */
 #endif /* NETWORK_ADMIN_H */
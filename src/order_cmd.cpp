@@ -374,21 +374,9 @@ const Order *OrderList::GetBestLoadableNext(const Vehicle *v, const Order *o2, c
 	StationID st2 = o2->GetDestination();
 	const Station *cur_station = Station::Get(v->last_station_visited);
 	for (SmallPair<CargoID, uint> *i = capacities.Begin(); i != capacities.End(); ++i) {
-		const StationCargoPacketMap *loadable_packets = cur_station->goods[i->first].cargo.Packets();
-		uint loadable_cargo = 0;
-		std::pair<StationCargoPacketMap::const_iterator, StationCargoPacketMap::const_iterator> p =
-			loadable_packets->equal_range(st1);
-		for (StationCargoPacketMap::const_iterator j = p.first; j != p.second; ++j) {
-			loadable_cargo = (*j)->Count();
-		}
-		loadable1 += min(i->second, loadable_cargo);
-
-		loadable_cargo = 0;
-		p = loadable_packets->equal_range(st2);
-		for (StationCargoPacketMap::const_iterator j = p.first; j != p.second; ++j) {
-			loadable_cargo = (*j)->Count();
-		}
-		loadable2 += min(i->second, loadable_cargo);
+		const StationCargoList &cargo = cur_station->goods[i->first].cargo;
+		loadable1 += min(i->second, cargo.NextHopCount(st1));
+		loadable2 += min(i->second, cargo.NextHopCount(st2));
 	}
 	if (loadable1 == loadable2) return RandomRange(2) == 0 ? o1 : o2;
 	return loadable1 > loadable2 ? o1 : o2;
@@ -14,6 +14,7 @@
 #include "../../tunnelbridge.h"
 #include "../../ship.h"
 #include "../../core/random_func.hpp"
+#include "../pf_stats.h"
 
 struct RememberData {
 	uint16 cur_length;
@@ -32,6 +33,8 @@ struct TrackPathFinder {
 
 static bool ShipTrackFollower(TileIndex tile, TrackPathFinder *pfs, uint length)
 {
+	PathfinderStatsAddNodes(1);
+
 	/* Found dest? */
 	if (tile == pfs->dest_coords) {
 		pfs->best_bird_dist = 0;
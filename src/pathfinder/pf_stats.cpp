@@ -0,0 +1,265 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file pf_stats.cpp Statistics of the path finder calls of vehicles, per day. */
+
+#include "../stdafx.h"
+#include "../vehicle_base.h"
+#include "../date_func.h"
+#include "../console_func.h"
+#include "../fileio_func.h"
+#include "../settings_type.h"
+#include "../string_func.h"
+#include "../core/alloc_func.hpp"
+#include "../core/mem_func.hpp"
+#include "../core/smallvec_type.hpp"
+#include "pf_stats.h"
+
+PathfinderCallTimer *_pf_current_call = NULL; ///< The outermost path finder call that is being measured.
+
+/** The time of the path finder calls of a vehicle on the current day. */
+struct PathfinderVehicleDay {
+	VehicleType type; ///< Type of the vehicle.
+	uint calls;       ///< Number of calls.
+	uint64 ticks;     ///< Total time of the calls in time stamp counter ticks.
+};
+
+/** The time of the path finder calls of all vehicles for one path finder on the current day. */
+struct PathfinderVehicleDays {
+	PathfinderVehicleDay *vehicles;  ///< Time per vehicle, indexed by vehicle ID.
+	uint size;                       ///< Number of vehicles #vehicles has room for.
+	SmallVector<VehicleID, 64> used; ///< The vehicles with calls on the current day.
+};
+
+static PathfinderDayStats _pf_stats[PF_STATS_DAYS];                 ///< Ring buffer of the statistics of the last days.
+static uint _pf_stats_today = 0;                                    ///< Index of the current day in #_pf_stats.
+static uint _pf_stats_num_days = 0;                                 ///< Number of days in #_pf_stats.
+static PathfinderVehicleDays _pf_stats_vehicles[PF_STATS_PATHFINDERS]; ///< Time per path finder and vehicle on the current day.
+
+static const char * const _pf_stats_vehicle_names[] = { "train", "road", "ship", "aircraft" };
+static const char * const _pf_stats_pathfinder_names[] = { "OPF", "NPF", "YAPF" };
+assert_compile(lengthof(_pf_stats_vehicle_names) == VEH_COMPANY_END);
+assert_compile(lengthof(_pf_stats_pathfinder_names) == PF_STATS_PATHFINDERS);
+
+/**
+ * Get the statistics of a day.
+ * @param age Number of days before the current day.
+ * @return The statistics.
+ * @pre age < _pf_stats_num_days
+ */
+static PathfinderDayStats *GetPathfinderDayStats(uint age)
+{
+	return &_pf_stats[(_pf_stats_today + PF_STATS_DAYS - age) % PF_STATS_DAYS];
+}
+
+/** Fill the lists of the vehicles that took the most time on the current day. */
+static void UpdateWorstVehicles()
+{
+	PathfinderDayStats *day = GetPathfinderDayStats(0);
+	for (uint pf = 0; pf < PF_STATS_PATHFINDERS; pf++) {
+		for (uint type = 0; type < VEH_COMPANY_END; type++) {
+			PathfinderVehicleTime *worst = day->stats[type][pf].worst;
+			for (uint i = 0; i < PF_STATS_WORST_VEHICLES; i++) worst[i].veh = INVALID_VEHICLE;
+		}
+
+		const PathfinderVehicleDays *days = &_pf_stats_vehicles[pf];
+		for (const VehicleID *it = days->used.Begin(); it != days->used.End(); it++) {
+			const PathfinderVehicleDay *vehicle = &days->vehicles[*it];
+			PathfinderVehicleTime *worst = day->stats[vehicle->type][pf].worst;
+
+			/* Insertion into the list sorted by time, dropping the last entry. */
+			uint i = PF_STATS_WORST_VEHICLES;
+			while (i > 0 && (worst[i - 1].veh == INVALID_VEHICLE || worst[i - 1].ticks < vehicle->ticks)) i--;
+			if (i == PF_STATS_WORST_VEHICLES) continue;
+			MemMoveT(worst + i + 1, worst + i, PF_STATS_WORST_VEHICLES - i - 1);
+			worst[i].veh = *it;
+			worst[i].calls = vehicle->calls;
+			worst[i].ticks = vehicle->ticks;
+		}
+	}
+}
+
+/** Forget the time per vehicle of the current day. */
+static void ClearPathfinderVehicleDays()
+{
+	for (uint pf = 0; pf < PF_STATS_PATHFINDERS; pf++) {
+		PathfinderVehicleDays *days = &_pf_stats_vehicles[pf];
+		for (const VehicleID *it = days->used.Begin(); it != days->used.End(); it++) days->vehicles[*it].calls = 0;
+		days->used.Clear();
+	}
+}
+
+/** Start collecting the statistics of a new day when the date changed. */
+static void UpdatePathfinderStatsDay()
+{
+	if (_pf_stats_num_days != 0 && GetPathfinderDayStats(0)->date == _date) return;
+
+	if (_pf_stats_num_days != 0) {
+		UpdateWorstVehicles();
+		_pf_stats_today = (_pf_stats_today + 1) % PF_STATS_DAYS;
+	}
+	_pf_stats_num_days = min(_pf_stats_num_days + 1, PF_STATS_DAYS);
+	ClearPathfinderVehicleDays();
+
+	PathfinderDayStats *day = GetPathfinderDayStats(0);
+	MemSetT(day, 0);
+	day->date = _date;
+}
+
+/**
+ * Start measuring a path finder call, when statistics are being collected and
+ * no other call is being measured already.
+ * @param v  The vehicle the path is searched for.
+ * @param pf The path finder that searches, one of #VehiclePathFinders.
+ */
+PathfinderCallTimer::PathfinderCallTimer(const Vehicle *v, uint8 pf) : nodes(0), cache_hits(0), veh(NULL), pf(pf)
+{
+	if (_pf_current_call != NULL || !_settings_game.pf.collect_statistics) return;
+	if (v->type >= VEH_COMPANY_END || pf >= PF_STATS_PATHFINDERS) return;
+
+	this->veh = v;
+	_pf_current_call = this;
+	this->perf.Start();
+}
+
+/** Stop measuring the path finder call and add it to the statistics. */
+PathfinderCallTimer::~PathfinderCallTimer()
+{
+	if (this->veh == NULL) return;
+	this->perf.Stop();
+	_pf_current_call = NULL;
+
+	UpdatePathfinderStatsDay();
+
+	/* Raw ticks; converting them to time would need the real clock rate of the CPU. */
+	uint64 ticks = max<int64>(this->perf.m_acc, 0);
+	PathfinderCallStats *stats = &GetPathfinderDayStats(0)->stats[this->veh->type][this->pf];
+	stats->calls++;
+	stats->nodes += this->nodes;
+	stats->cache_hits += this->cache_hits;
+	stats->ticks += ticks;
+
+	uint bucket = 0;
+	for (uint64 limit = 10000; bucket < PF_STATS_TIME_BUCKETS - 1 && ticks >= limit; limit *= 10) bucket++;
+	stats->histogram[bucket]++;
+
+	PathfinderVehicleDays *days = &_pf_stats_vehicles[this->pf];
+	VehicleID index = this->veh->index;
+	if (index >= days->size) {
+		uint size = max<uint>(Vehicle::GetPoolSize(), index + 1);
+		days->vehicles = ReallocT(days->vehicles, size);
+		MemSetT(days->vehicles + days->size, 0, size - days->size);
+		days->size = size;
+	}
+
+	PathfinderVehicleDay *vehicle = &days->vehicles[index];
+	if (vehicle->calls == 0) {
+		*days->used.Append() = index;
+		vehicle->type = this->veh->type;
+		vehicle->ticks = 0;
+	}
+	vehicle->calls++;
+	vehicle->ticks += ticks;
+}
+
+/** Forget the statistics of all days. */
+void ResetPathfinderStats()
+{
+	_pf_stats_num_days = 0;
+	ClearPathfinderVehicleDays();
+}
+
+/**
+ * Print the statistics of the last days to the console.
+ * Times are in ticks of the CPU's time stamp counter.
+ * @param days Number of days to print, starting with the current day.
+ */
+void PrintPathfinderStats(uint days)
+{
+	if (_pf_stats_num_days == 0) {
+		IConsolePrint(CC_DEFAULT, _settings_game.pf.collect_statistics ? "No path finder calls measured yet." : "Path finder statistics are not collected; enable them with 'set pf.collect_statistics 1'.");
+		return;
+	}
+	UpdateWorstVehicles();
+
+	for (uint age = 0; age < min(days, _pf_stats_num_days); age++) {
+		const PathfinderDayStats *day = GetPathfinderDayStats(age);
+		YearMonthDay ymd;
+		ConvertDateToYMD(day->date, &ymd);
+		IConsolePrintF(CC_WHITE, "%d-%02d-%02d:", ymd.year, ymd.month + 1, ymd.day);
+
+		for (uint type = 0; type < VEH_COMPANY_END; type++) {
+			for (uint pf = 0; pf < PF_STATS_PATHFINDERS; pf++) {
+				const PathfinderCallStats *stats = &day->stats[type][pf];
+				if (stats->calls == 0) continue;
+
+				IConsolePrintF(CC_DEFAULT, "  %-8s %-4s %7u calls, " OTTD_PRINTF64 " nodes, " OTTD_PRINTF64 " cache hits, " OTTD_PRINTF64 " ticks, " OTTD_PRINTF64 " ticks per call",
+						_pf_stats_vehicle_names[type], _pf_stats_pathfinder_names[pf], stats->calls, stats->nodes, stats->cache_hits,
+						stats->ticks, stats->ticks / stats->calls);
+				IConsolePrintF(CC_DEFAULT, "    calls taking <10^4 ticks: %u, <10^5: %u, <10^6: %u, <10^7: %u, <10^8: %u, more: %u",
+						stats->histogram[0], stats->histogram[1], stats->histogram[2], stats->histogram[3], stats->histogram[4], stats->histogram[5]);
+
+				for (uint i = 0; i < PF_STATS_WORST_VEHICLES && stats->worst[i].veh != INVALID_VEHICLE; i++) {
+					const Vehicle *v = Vehicle::GetIfValid(stats->worst[i].veh);
+					IConsolePrintF(CC_DEFAULT, "    vehicle %u (unit %u of company %u): " OTTD_PRINTF64 " ticks in %u calls",
+							stats->worst[i].veh, v != NULL ? v->unitnumber : 0, v != NULL ? v->owner + 1 : 0, stats->worst[i].ticks, stats->worst[i].calls);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Write the statistics of all kept days to a CSV file in the autosave
+ * directory, one line per day, vehicle type and path finder.
+ * @param filename The name of the file, without any directory.
+ * @return Whether the file could be written.
+ */
+bool ExportPathfinderStats(const char *filename)
+{
+	/* Only allow files in the autosave directory. */
+	if (StrEmpty(filename) || strchr(filename, '/') != NULL || strchr(filename, '\\') != NULL || strstr(filename, "..") != NULL) {
+		return false;
+	}
+
+	FILE *f = FioFOpenFile(filename, "w", AUTOSAVE_DIR);
+	if (f == NULL) return false;
+
+	if (_pf_stats_num_days != 0) UpdateWorstVehicles();
+
+	fprintf(f, "date,vehicle_type,pathfinder,calls,nodes,cache_hits,ticks,calls_below_1e4_ticks,calls_below_1e5_ticks,calls_below_1e6_ticks,calls_below_1e7_ticks,calls_below_1e8_ticks,calls_above_1e8_ticks,worst_vehicles\n");
+	for (uint age = _pf_stats_num_days; age-- > 0;) {
+		const PathfinderDayStats *day = GetPathfinderDayStats(age);
+		YearMonthDay ymd;
+		ConvertDateToYMD(day->date, &ymd);
+
+		for (uint type = 0; type < VEH_COMPANY_END; type++) {
+			for (uint pf = 0; pf < PF_STATS_PATHFINDERS; pf++) {
+				const PathfinderCallStats *stats = &day->stats[type][pf];
+				if (stats->calls == 0) continue;
+
+				fprintf(f, "%d-%02d-%02d,%s,%s,%u," OTTD_PRINTF64 "," OTTD_PRINTF64 "," OTTD_PRINTF64, ymd.year, ymd.month + 1, ymd.day,
+						_pf_stats_vehicle_names[type], _pf_stats_pathfinder_names[pf], stats->calls, stats->nodes, stats->cache_hits, stats->ticks);
+				for (uint i = 0; i < PF_STATS_TIME_BUCKETS; i++) fprintf(f, ",%u", stats->histogram[i]);
+
+				/* The vehicles as "id:ticks" separated by spaces, to keep one column. */
+				fprintf(f, ",");
+				for (uint i = 0; i < PF_STATS_WORST_VEHICLES && stats->worst[i].veh != INVALID_VEHICLE; i++) {
+					if (i != 0) fprintf(f, " ");
+					fprintf(f, "%u:" OTTD_PRINTF64, stats->worst[i].veh, stats->worst[i].ticks);
+				}
+				fprintf(f, "\n");
+			}
+		}
+	}
+
+	bool ok = ferror(f) == 0;
+	fclose(f);
+	return ok;
+}
@@ -0,0 +1,95 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file pf_stats.h Statistics of the path finder calls of vehicles, per day. */
+
+#ifndef PF_STATS_H
+#define PF_STATS_H
+
+#include "../vehicle_type.h"
+#include "../date_type.h"
+#include "pf_performance_timer.hpp"
+
+static const uint PF_STATS_PATHFINDERS    = VPF_YAPF + 1; ///< Number of path finders.
+static const uint PF_STATS_TIME_BUCKETS   = 6;            ///< Number of buckets of the call time histogram: below 10^4, 10^5, 10^6, 10^7, 10^8 ticks and the rest.
+static const uint PF_STATS_WORST_VEHICLES = 5;            ///< Number of vehicles that took the most time kept per vehicle type and path finder.
+static const uint PF_STATS_DAYS           = 30;           ///< Number of days the statistics are kept for.
+
+/**
+ * The time the path finder calls of a vehicle took. Times are raw ticks of the
+ * CPU's time stamp counter, as the clock rate isn't known.
+ */
+struct PathfinderVehicleTime {
+	VehicleID veh; ///< The vehicle, or INVALID_VEHICLE for an unused entry.
+	uint calls;    ///< Number of calls.
+	uint64 ticks;  ///< Total time of the calls in time stamp counter ticks.
+};
+
+/** Statistics of the calls of one path finder for one vehicle type. */
+struct PathfinderCallStats {
+	uint calls;                                           ///< Number of calls.
+	uint64 nodes;                                         ///< Number of nodes expanded.
+	uint64 cache_hits;                                    ///< Number of results taken from a cache instead of calculated.
+	uint64 ticks;                                         ///< Total time of the calls in time stamp counter ticks.
+	uint histogram[PF_STATS_TIME_BUCKETS];                ///< Number of calls per time bucket.
+	PathfinderVehicleTime worst[PF_STATS_WORST_VEHICLES]; ///< Vehicles that took the most time, the most first.
+};
+
+/** Statistics of the path finder calls of one day. */
+struct PathfinderDayStats {
+	Date date;                                                        ///< The day.
+	PathfinderCallStats stats[VEH_COMPANY_END][PF_STATS_PATHFINDERS]; ///< Statistics per vehicle type and path finder.
+};
+
+/**
+ * Measures a path finder call for a vehicle from construction to destruction,
+ * and adds it to the statistics of the current day. Only done when statistics
+ * are being collected, and only for the outermost call, so nested calls don't
+ * count their time twice; the nodes and cache hits of nested calls are added
+ * to the outermost call.
+ */
+class PathfinderCallTimer {
+public:
+	uint nodes;      ///< Nodes expanded during the call.
+	uint cache_hits; ///< Cache hits during the call.
+
+	PathfinderCallTimer(const Vehicle *v, uint8 pf);
+	~PathfinderCallTimer();
+
+private:
+	const Vehicle *veh;     ///< The vehicle the path is searched for, or NULL when the call isn't measured.
+	uint8 pf;               ///< The path finder that searches.
+	CPerformanceTimer perf; ///< The time of the call.
+};
+
+extern PathfinderCallTimer *_pf_current_call;
+
+/**
+ * Count nodes expanded by the path finder call that is being measured.
+ * @param nodes Number of nodes.
+ */
+static inline void PathfinderStatsAddNodes(uint nodes)
+{
+	if (_pf_current_call != NULL) _pf_current_call->nodes += nodes;
+}
+
+/**
+ * Count cache hits of the path finder call that is being measured.
+ * @param hits Number of hits.
+ */
+static inline void PathfinderStatsAddCacheHits(uint hits)
+{
+	if (_pf_current_call != NULL) _pf_current_call->cache_hits += hits;
+}
+
+void ResetPathfinderStats();
+void PrintPathfinderStats(uint days);
+bool ExportPathfinderStats(const char *filename);
+
+#endif /* PF_STATS_H */
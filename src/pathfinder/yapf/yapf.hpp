@@ -15,6 +15,7 @@
 #include "../../landscape.h"
 #include "../pathfinder_func.h"
 #include "../pf_performance_timer.hpp"
+#include "../pf_stats.h"
 #include "yapf.h"
 
 //#undef FORCEINLINE
@@ -121,6 +121,8 @@ public:
 	inline bool FindPath(const VehicleType *v)
 	{
 		m_veh = v;
+		int start_steps = m_num_steps;
+		int start_cache_hits = m_stats_cache_hits;
 
 #ifndef NO_DEBUG_MESSAGES
 		CPerformanceTimer perf;
@@ -154,6 +156,9 @@ public:
 
 		bDestFound &= (m_pBestDestNode != NULL);
 
+		PathfinderStatsAddNodes(m_num_steps - start_steps);
+		PathfinderStatsAddCacheHits(m_stats_cache_hits - start_cache_hits);
+
 #ifndef NO_DEBUG_MESSAGES
 		perf.Stop();
 		if (_debug_yapf_level >= 2) {
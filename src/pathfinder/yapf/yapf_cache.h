@@ -13,6 +13,7 @@
 #define YAPF_CACHE_H
 
 #include "../../track_type.h"
+#include "../../company_type.h"
 
 /**
  * Use this function to notify YAPF that track layout (or signal configuration) has change.
@@ -21,4 +22,29 @@
  */
 void YapfNotifyTrackLayoutChange(TileIndex tile, Track track);
 
+/**
+ * Use this function to notify YAPF that road layout has changed.
+ * @param tile the tile that is changed, or INVALID_TILE when everything might have changed
+ */
+void YapfNotifyRoadLayoutChange(TileIndex tile);
+
+/**
+ * Use this function to notify YAPF that the cost of driving over a tile has changed
+ *  without changing the road layout, e.g. by road works or terraforming.
+ * @param tile the tile that is changed, or INVALID_TILE when everything might have changed
+ */
+void YapfNotifyRoadCostChange(TileIndex tile);
+
+/**
+ * Use this function to notify YAPF that a company no longer owns anything, so the
+ *  rail segment cost caches of the company can be emptied.
+ * @param owner the company
+ */
+void YapfNotifyCompanyRemoved(Owner owner);
+
+/**
+ * Print the statistics of the rail segment cost caches, per company and rail type, to the console.
+ */
+void YapfPrintSegmentCacheStats();
+
 #endif /* YAPF_CACHE_H */
@@ -0,0 +1,203 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file yapf_connectivity.cpp Implementation of the connected components of the rail and road networks. */
+
+#include "../../stdafx.h"
+#include "../../debug.h"
+#include "../../landscape.h"
+#include "../../road_map.h"
+#include "../../station_map.h"
+#include "../../tunnelbridge_map.h"
+#include "../../core/alloc_func.hpp"
+#include "../../core/mem_func.hpp"
+#include "../../core/smallvec_type.hpp"
+#include "yapf_connectivity.h"
+
+CYapfConnectivity _yapf_rail_connectivity(TRANSPORT_RAIL); ///< components of the rail network
+CYapfConnectivity _yapf_road_connectivity(TRANSPORT_ROAD); ///< components of the road and tram networks
+
+CYapfConnectivity::CYapfConnectivity(TransportType transport) : m_transport(transport), m_valid(false), m_components(NULL), m_states(NULL), m_size(0)
+{
+}
+
+CYapfConnectivity::~CYapfConnectivity()
+{
+	free(m_components);
+	free(m_states);
+}
+
+/**
+ * Remember that the rail or road on a tile changed; the components are updated
+ *  the next time they are needed, when the change is complete.
+ * @param tile the changed tile, or INVALID_TILE when anything might have changed
+ */
+void CYapfConnectivity::Notify(TileIndex tile)
+{
+	if (!m_valid) return;
+	if (tile == INVALID_TILE || m_dirty.Length() >= C_MAX_DIRTY) {
+		Invalidate();
+		return;
+	}
+	m_dirty.Include(tile);
+}
+
+/**
+ * Get the edges of a tile a vehicle can leave it through.
+ * @param tile the tile
+ * @return bitmask of DiagDirections
+ */
+uint CYapfConnectivity::GetExits(TileIndex tile) const
+{
+	uint exits = 0;
+	if (m_transport == TRANSPORT_RAIL) {
+		TrackdirBits trackdirs = TrackStatusToTrackdirBits(GetTileTrackStatus(tile, TRANSPORT_RAIL, 0));
+		while (trackdirs != TRACKDIR_BIT_NONE) SetBit(exits, TrackdirToExitdir(RemoveFirstTrackdir(&trackdirs)));
+		return exits;
+	}
+
+	/* Not GetTileTrackStatus, as road works would make the components depend on time. */
+	switch (GetTileType(tile)) {
+		case MP_ROAD: break;
+		case MP_STATION: if (!IsRoadStop(tile)) return 0; break;
+		case MP_TUNNELBRIDGE: if (GetTunnelBridgeTransportType(tile) != TRANSPORT_ROAD) return 0; break;
+		default: return 0;
+	}
+	RoadBits bits = GetAnyRoadBits(tile, ROADTYPE_ROAD, true) | GetAnyRoadBits(tile, ROADTYPE_TRAM, true);
+	for (DiagDirection dir = DIAGDIR_BEGIN; dir < DIAGDIR_END; dir++) {
+		if ((bits & DiagDirToRoadBits(dir)) != ROAD_NONE) SetBit(exits, dir);
+	}
+	return exits;
+}
+
+/**
+ * Get the state of a tile the components depend on.
+ * @param tile the tile
+ * @return the exits of the tile, plus C_TUNNELBRIDGE for tunnel and bridge heads
+ */
+uint8 CYapfConnectivity::GetState(TileIndex tile) const
+{
+	uint8 exits = GetExits(tile);
+	if (exits != 0 && IsTileType(tile, MP_TUNNELBRIDGE)) exits |= C_TUNNELBRIDGE;
+	return exits;
+}
+
+/**
+ * Get the tile a vehicle gets to when leaving a tile through the given edge.
+ * @param tile the tile
+ * @param dir  the edge
+ * @return the next tile, which is the other end for tunnels and bridges
+ */
+TileIndex CYapfConnectivity::GetNeighbour(TileIndex tile, DiagDirection dir) const
+{
+	if (IsTileType(tile, MP_TUNNELBRIDGE) && GetTunnelBridgeDirection(tile) == dir) return GetOtherTunnelBridgeEnd(tile);
+	return TileAddByDiagDir(tile, dir);
+}
+
+/**
+ * Is a tile linked to its neighbour in the given direction? Both tiles have to
+ *  lead to each other, so e.g. a tunnel entrance isn't linked to the tile on
+ *  the hill above it.
+ * @param tile      the tile
+ * @param dir       the edge of the tile to leave through
+ * @param neighbour [out] the neighbour in that direction
+ * @return whether the tiles are linked
+ */
+bool CYapfConnectivity::IsLinked(TileIndex tile, DiagDirection dir, TileIndex *neighbour) const
+{
+	*neighbour = GetNeighbour(tile, dir);
+	DiagDirection back = ReverseDiagDir(dir);
+	return HasBit(GetExits(*neighbour), back) && GetNeighbour(*neighbour, back) == tile;
+}
+
+/** Bring the components up to date with the current layout. */
+void CYapfConnectivity::Update()
+{
+	if (!m_valid || !MergeChanges()) Rebuild();
+	m_dirty.Clear();
+}
+
+/**
+ * Merge the components linked by the changed tiles. This is only possible when
+ *  the tiles didn't lose any links, as splitting a component would need a flood
+ *  fill of it. The components stay the same as those Rebuild would calculate.
+ * @return false if a tile might have lost a link
+ */
+bool CYapfConnectivity::MergeChanges()
+{
+	for (const TileIndex *it = m_dirty.Begin(); it != m_dirty.End(); it++) {
+		TileIndex tile = *it;
+		uint8 old_state = m_states[tile];
+		uint8 state = GetState(tile);
+		if (old_state == 0) {
+			/* Tiles without exits had no links to lose. */
+			if (state == 0) continue;
+		} else if ((old_state & C_TUNNELBRIDGE) != 0 || (old_state & ~state) != 0) {
+			/* Lost an exit, or a tunnel or bridge that might lead elsewhere now. */
+			return false;
+		}
+		m_states[tile] = state;
+
+		if (m_components[tile] == 0) {
+			m_components[tile] = m_parents.Length();
+			*m_parents.Append() = m_components[tile];
+		}
+
+		for (DiagDirection dir = DIAGDIR_BEGIN; dir < DIAGDIR_END; dir++) {
+			TileIndex next;
+			if (!HasBit(state, dir) || !IsLinked(tile, dir, &next) || m_components[next] == 0) continue;
+			/* A linked tile without a component yet is changed too and gets linked back then. */
+			uint32 root = FindRoot(m_components[tile]);
+			uint32 next_root = FindRoot(m_components[next]);
+			if (root != next_root) m_parents[max(root, next_root)] = min(root, next_root);
+		}
+	}
+	return true;
+}
+
+/** Calculate the components of the current layout by flood filling from every tile not in a component yet. */
+void CYapfConnectivity::Rebuild()
+{
+	if (m_size != MapSize()) {
+		free(m_components);
+		free(m_states);
+		m_size = MapSize();
+		m_components = MallocT<uint32>(m_size);
+		m_states = MallocT<uint8>(m_size);
+	}
+	MemSetT(m_components, 0, m_size);
+	for (TileIndex tile = 0; tile < m_size; tile++) m_states[tile] = GetState(tile);
+
+	uint32 num_components = 0;
+	m_parents.Clear();
+	*m_parents.Append() = 0;
+	SmallVector<TileIndex, 256> todo;
+	for (TileIndex tile = 0; tile < m_size; tile++) {
+		if (m_components[tile] != 0 || m_states[tile] == 0) continue;
+
+		m_components[tile] = ++num_components;
+		*m_parents.Append() = num_components;
+		*todo.Append() = tile;
+		while (todo.Length() != 0) {
+			TileIndex cur = *(todo.End() - 1);
+			todo.Erase(todo.End() - 1);
+
+			uint exits = m_states[cur];
+			for (DiagDirection dir = DIAGDIR_BEGIN; dir < DIAGDIR_END; dir++) {
+				TileIndex next;
+				if (!HasBit(exits, dir) || !IsLinked(cur, dir, &next) || m_components[next] != 0) continue;
+				m_components[next] = num_components;
+				*todo.Append() = next;
+			}
+		}
+	}
+
+	m_valid = true;
+	DEBUG(yapf, 2, "%s network has %u connected components", m_transport == TRANSPORT_RAIL ? "Rail" : "Road", num_components);
+}
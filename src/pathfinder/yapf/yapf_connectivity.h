@@ -0,0 +1,98 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file yapf_connectivity.h Connected components of the rail and road networks. */
+
+#ifndef YAPF_CONNECTIVITY_H
+#define YAPF_CONNECTIVITY_H
+
+#include "../../tile_type.h"
+#include "../../transport_type.h"
+#include "../../direction_type.h"
+#include "../../core/smallvec_type.hpp"
+
+/**
+ * Splits the tiles with rail or road into connected components, so the path finders
+ *  can tell that a destination can't be reached without searching. Links between tiles
+ *  ignore direction, signals, one way roads and rail/road types, so two tiles in the
+ *  same component aren't necessarily connected, but two tiles in different components
+ *  are never connected.
+ *
+ * The components only depend on the track/road layout, so every client gets the same
+ *  answers. Changed tiles are only looked at when the components are needed. When they
+ *  only gained links, the components they link are merged; otherwise, or after too many
+ *  changes, all components are calculated again.
+ */
+class CYapfConnectivity {
+public:
+	CYapfConnectivity(TransportType transport);
+	~CYapfConnectivity();
+
+	/** Forget the components; they are calculated again when needed. */
+	inline void Invalidate()
+	{
+		m_valid = false;
+		m_dirty.Clear();
+	}
+
+	void Notify(TileIndex tile);
+
+	/**
+	 * Might there be a path between the given tiles?
+	 * @param from tile the path starts at
+	 * @param to   tile the path ends at
+	 * @return false if the tiles are certainly not connected
+	 */
+	inline bool MightBeConnected(TileIndex from, TileIndex to)
+	{
+		if (!m_valid || m_dirty.Length() != 0) Update();
+		/* Don't reject anything when starting from a tile we know nothing about. */
+		return m_components[from] == 0 || FindRoot(m_components[from]) == FindRoot(m_components[to]);
+	}
+
+private:
+	static const uint C_MAX_DIRTY = 1024;     ///< number of changed tiles after which the components are calculated again instead of merged
+	static const uint8 C_TUNNELBRIDGE = 0x10; ///< tile state flag for tunnel and bridge heads, which link to their other end
+
+	TransportType m_transport;               ///< the transport type of the tiles
+	bool          m_valid;                   ///< whether the components match the layout, apart from the tiles in m_dirty
+	uint32       *m_components;              ///< component of each tile; 0 for tiles without rail or road
+	uint8        *m_states;                  ///< exits of each tile when the components were last updated, plus C_TUNNELBRIDGE
+	uint          m_size;                    ///< number of tiles m_components was allocated for
+	SmallVector<uint32, 256>   m_parents;    ///< component each component was merged into; itself when it wasn't
+	SmallVector<TileIndex, 64> m_dirty;      ///< tiles changed since the components were last updated
+
+	/**
+	 * Find the component a component was merged into.
+	 * @param component the component
+	 * @return the component that contains it
+	 */
+	inline uint32 FindRoot(uint32 component)
+	{
+		while (m_parents[component] != component) {
+			/* Path halving, to keep later lookups short. */
+			m_parents[component] = m_parents[m_parents[component]];
+			component = m_parents[component];
+		}
+		return component;
+	}
+
+	void Update();
+	void Rebuild();
+	bool MergeChanges();
+	uint8 GetState(TileIndex tile) const;
+	uint GetExits(TileIndex tile) const;
+	TileIndex GetNeighbour(TileIndex tile, DiagDirection dir) const;
+	bool IsLinked(TileIndex tile, DiagDirection dir, TileIndex *neighbour) const;
+};
+
+extern CYapfConnectivity _yapf_rail_connectivity;
+extern CYapfConnectivity _yapf_road_connectivity;
+
+#endif /* YAPF_CONNECTIVITY_H */
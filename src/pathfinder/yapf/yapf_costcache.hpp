@@ -13,6 +13,11 @@
 #define YAPF_COSTCACHE_HPP
 
 #include "../../date_func.h"
+#include "../../map_func.h"
+#include "../../company_type.h"
+#include "../../rail_type.h"
+#include <map>
+#include <algorithm>
 
 /**
  * CYapfSegmentCostCacheNoneT - the formal only yapf cost cache provider that implements
@@ -94,17 +99,70 @@ public:
 
 /**
  * Base class for segment cost cache providers. Contains global counter
- *  of track layout changes and static notification function called whenever
- *  the track layout changes. It is implemented as base class because it needs
- *  to be shared between all rail YAPF types (one shared counter, one notification
- *  function.
+ *  of track layout changes, the log of the most recent changed tiles and
+ *  static notification function called whenever the track layout changes.
+ *  It is implemented as base class because it needs to be shared between
+ *  all rail YAPF types (one shared counter, one notification function).
+ *  It also keeps the statistics of each cache and a list of all caches,
+ *  so they can be shown without knowing the segment types.
  */
 struct CSegmentCostCacheBase
 {
-	static int   s_rail_change_counter;
+	static const uint C_CHANGE_LOG_SIZE = 1024; ///< number of track layout changes remembered by the change log
+
+	static uint      s_rail_change_counter;
+	static TileIndex s_rail_changed_tiles[C_CHANGE_LOG_SIZE];
+	static SmallVector<CSegmentCostCacheBase *, 32> s_caches; ///< all caches that were created
+
+	Owner     m_owner;         ///< company whose trains use the cache
+	RailType  m_railtype;      ///< rail type of the trains that use the cache
+	uint      m_segments;      ///< number of cached segments, updated before each path finder run
+	size_t    m_memory;        ///< estimated memory used by the cache, updated before each path finder run
+	uint64    m_hits;          ///< number of segments found in the cache
+	uint64    m_misses;        ///< number of segments not found in the cache
+	uint64    m_evictions;     ///< number of segments evicted to stay within the memory budget
+	uint64    m_invalidations; ///< number of segments invalidated by track layout changes
+	uint      m_flushes;       ///< number of times the whole cache was flushed
+
+	inline CSegmentCostCacheBase(Owner owner, RailType railtype)
+		: m_owner(owner), m_railtype(railtype), m_segments(0), m_memory(0)
+		, m_hits(0), m_misses(0), m_evictions(0), m_invalidations(0), m_flushes(0)
+	{
+		*s_caches.Append() = this;
+	}
+
+	virtual ~CSegmentCostCacheBase()
+	{
+		s_caches.Erase(s_caches.Find(this));
+	}
+
+	/** Forget all cached segments. */
+	virtual void Flush() = 0;
+
+	/**
+	 * Empty the caches of a company and reset their statistics, so a new company
+	 *  in the same slot starts without them.
+	 */
+	static void FlushCompany(Owner owner)
+	{
+		for (CSegmentCostCacheBase **it = s_caches.Begin(); it != s_caches.End(); it++) {
+			CSegmentCostCacheBase *cache = *it;
+			if (cache->m_owner != owner) continue;
+			cache->Flush();
+			cache->m_segments = 0;
+			cache->m_memory = 0;
+			cache->m_hits = cache->m_misses = cache->m_evictions = cache->m_invalidations = 0;
+			cache->m_flushes = 0;
+		}
+	}
 
+	/**
+	 * Record a track layout change. Change number N is kept in the change log
+	 *  at N % C_CHANGE_LOG_SIZE; INVALID_TILE means the whole cache has to go.
+	 */
 	static void NotifyTrackLayoutChange(TileIndex tile, Track track)
 	{
+		s_rail_changed_tiles[s_rail_change_counter % C_CHANGE_LOG_SIZE] = tile;
 		s_rail_change_counter++;
 	}
 };
@@ -119,27 +177,51 @@ struct CSegmentCostCacheBase
  *  of the segment (origin tile and exit-dir from this tile).
  *  Different CYapfCachedCostT types can share the same type of CSegmentCostCacheT.
  *  Look at CYapfRailSegment (yapf_node_rail.hpp) for the segment example
+ *
+ *  Besides the hash-map the cache keeps an index from map areas to the segments
+ *  that depend on a tile in that area, so a track layout change only invalidates
+ *  the segments around the changed tile. The whole cache is flushed only when
+ *  asked to, when more changes happened than the change log can hold, or when
+ *  the area index grows too large.
+ *
+ *  There is one cache per company and rail type, each of them kept within a memory
+ *  budget by evicting the least recently used segments between path finder runs.
+ *  Tsegment needs a m_last_use member for that. Slots of evicted segments are
+ *  reused for new segments, the storage itself is only freed by a flush.
  */
 template <class Tsegment>
 struct CSegmentCostCacheT
 	: public CSegmentCostCacheBase
 {
 	static const int C_HASH_BITS = 14;
+	static const uint C_AREA_BITS = 3;               ///< log2 of the width/height of an area of the area index
+	static const uint C_MAX_AREAS_PER_SEGMENT = 8;   ///< average number of area index entries per segment before the cache is flushed
+	static const uint C_MIN_AREA_INDEX_SIZE = 1024;  ///< number of area index entries that never cause a flush
+	static const size_t C_AREA_INDEX_ENTRY_SIZE = 6 * sizeof(void *); ///< estimated memory used by an area index entry
 
 	typedef CHashTableT<Tsegment, C_HASH_BITS> HashTable;
 	typedef SmallArray<Tsegment> Heap;
 	typedef typename Tsegment::Key Key;    ///< key to hash table
+	typedef std::multimap<uint, Tsegment *> AreaIndex;
 
 	HashTable    m_map;
 	Heap         m_heap;
+	SmallVector<Tsegment *, 64> m_free; ///< slots of the heap whose segments were evicted
+	AreaIndex    m_areas;       ///< segments that depend on a tile in the given area
+	uint         m_last_change; ///< value of s_rail_change_counter when the track layout changes were last applied
+	uint32       m_run;         ///< number of the current path finder run, stamped on the segments it uses
 
-	inline CSegmentCostCacheT() {}
+	inline CSegmentCostCacheT(Owner owner, RailType railtype)
+		: CSegmentCostCacheBase(owner, railtype), m_last_change(s_rail_change_counter), m_run(0) {}
 
 	/** flush (clear) the cache */
-	inline void Flush()
+	virtual void Flush()
 	{
 		m_map.Clear();
 		m_heap.Clear();
+		m_free.Clear();
+		m_areas.clear();
+		m_flushes++;
 	}
 
 	inline Tsegment& Get(Key& key, bool *found)
@@ -147,13 +229,143 @@ struct CSegmentCostCacheT
 		Tsegment *item = m_map.Find(key);
 		if (item == NULL) {
 			*found = false;
-			item = new (m_heap.Append()) Tsegment(key);
+			m_misses++;
+			if (m_free.Length() != 0) {
+				item = new (m_free[m_free.Length() - 1]) Tsegment(key);
+				m_free.Erase(m_free.End() - 1);
+			} else {
+				item = new (m_heap.Append()) Tsegment(key);
+			}
 			m_map.Push(*item);
 		} else {
 			*found = true;
+			m_hits++;
 		}
+		item->m_last_use = m_run;
 		return *item;
 	}
+
+	/** Is the given slot of the heap in use by a cached segment? */
+	inline bool IsCached(Tsegment& segment)
+	{
+		return m_map.Find(segment.GetKey()) == &segment;
+	}
+
+	/** Get the estimated memory used by the cache, not counting the reusable slots of evicted segments. */
+	inline size_t GetMemoryUsage() const
+	{
+		return sizeof(*this) + (m_heap.Length() - m_free.Length()) * sizeof(Tsegment) + m_areas.size() * C_AREA_INDEX_ENTRY_SIZE;
+	}
+
+	/** Get the area of the area index the given tile belongs to. */
+	static inline uint GetArea(TileIndex tile)
+	{
+		return ((TileY(tile) >> C_AREA_BITS) << 16) | (TileX(tile) >> C_AREA_BITS);
+	}
+
+	/**
+	 * Remember that the cost of a segment depends on the given tiles.
+	 * @param segment the segment whose cost was calculated
+	 * @param begin first tile the segment depends on
+	 * @param end one past the last tile the segment depends on
+	 */
+	inline void AddTiles(Tsegment& segment, const TileIndex *begin, const TileIndex *end)
+	{
+		SmallVector<uint, 8> areas;
+		for (const TileIndex *tile = begin; tile != end; tile++) areas.Include(GetArea(*tile));
+		for (const uint *area = areas.Begin(); area != areas.End(); area++) {
+			m_areas.insert(std::make_pair(*area, &segment));
+		}
+	}
+
+	/** Invalidate the cost of all segments that depend on a tile in the given area. */
+	inline void InvalidateArea(uint area)
+	{
+		std::pair<typename AreaIndex::iterator, typename AreaIndex::iterator> range = m_areas.equal_range(area);
+		for (typename AreaIndex::iterator it = range.first; it != range.second; ++it) it->second->Invalidate();
+		m_invalidations += std::distance(range.first, range.second);
+		m_areas.erase(range.first, range.second);
+	}
+
+	/**
+	 * Apply the track layout changes since the last call. Must not be called
+	 *  while a path finder is using the cache, as it might flush it.
+	 */
+	inline void ApplyTrackLayoutChanges()
+	{
+		if (m_last_change == s_rail_change_counter) return;
+
+		if (s_rail_change_counter - m_last_change > C_CHANGE_LOG_SIZE ||
+				m_areas.size() > C_MAX_AREAS_PER_SEGMENT * m_heap.Length() + C_MIN_AREA_INDEX_SIZE) {
+			Flush();
+		} else {
+			for (uint change = m_last_change; change != s_rail_change_counter; change++) {
+				TileIndex tile = s_rail_changed_tiles[change % C_CHANGE_LOG_SIZE];
+				if (tile == INVALID_TILE) {
+					Flush();
+					break;
+				}
+				InvalidateArea(GetArea(tile));
+			}
+		}
+		m_last_change = s_rail_change_counter;
+	}
+
+	/**
+	 * Evict the least recently used segments when the cache uses more than
+	 *  the given memory budget, until a quarter of the budget is free again.
+	 *  Must not be called while a path finder is using the cache.
+	 * @param budget the memory budget of the cache in bytes
+	 */
+	inline void Trim(size_t budget)
+	{
+		uint live = m_heap.Length() - m_free.Length();
+		size_t memory = GetMemoryUsage();
+		if (memory <= budget || live == 0) return;
+
+		size_t fixed = sizeof(*this);
+		size_t per_segment = (memory - fixed) / live + 1;
+		size_t target = budget / 4 * 3;
+		uint keep = (target > fixed) ? (uint)min<size_t>(live, (target - fixed) / per_segment) : 0;
+		if (keep == live) return;
+
+		/* Find the last use of the most recently used segment that has to go. */
+		SmallVector<uint32, 64> uses;
+		for (uint i = 0; i < m_heap.Length(); i++) {
+			if (IsCached(m_heap[i])) *uses.Append() = m_heap[i].m_last_use;
+		}
+		uint evict = live - keep;
+		std::nth_element(uses.Begin(), uses.Begin() + evict - 1, uses.End());
+		uint32 cutoff = uses[evict - 1];
+
+		for (typename AreaIndex::iterator it = m_areas.begin(); it != m_areas.end();) {
+			if (it->second->m_last_use <= cutoff) {
+				m_areas.erase(it++);
+			} else {
+				++it;
+			}
+		}
+		for (uint i = 0; i < m_heap.Length(); i++) {
+			Tsegment &segment = m_heap[i];
+			if (segment.m_last_use > cutoff || !IsCached(segment)) continue;
+			m_map.Pop(segment);
+			*m_free.Append() = &segment;
+			m_evictions++;
+		}
+	}
+
+	/**
+	 * Prepare the cache for a path finder run.
+	 * @param budget the memory budget of the cache in bytes
+	 */
+	inline void BeginRun(size_t budget)
+	{
+		ApplyTrackLayoutChanges();
+		Trim(budget);
+		m_segments = m_heap.Length() - m_free.Length();
+		m_memory = GetMemoryUsage();
+		m_run++;
+	}
 };
 
 /**
@@ -175,9 +387,9 @@ public:
 	typedef CSegmentCostCacheT<CachedData> Cache;
 
 protected:
-	Cache&      m_global_cache;
+	Cache      *m_global_cache; ///< cache of the vehicle's company and rail type, NULL until it is needed
 
-	inline CYapfSegmentCostCacheGlobalT() : m_global_cache(stGetGlobalCache()) {};
+	inline CYapfSegmentCostCacheGlobalT() : m_global_cache(NULL) {};
 
 	/** to access inherited path finder */
 	inline Tpf& Yapf()
@@ -185,11 +397,22 @@ protected:
 		return *static_cast<Tpf*>(this);
 	}
 
-	inline static Cache& stGetGlobalCache()
+	/** The caches of this kind of path finder, per company and rail type; freed on exit. */
+	struct Partitions {
+		Cache *caches[MAX_COMPANIES][RAILTYPE_END];
+
+		~Partitions()
+		{
+			for (uint i = 0; i < MAX_COMPANIES; i++) {
+				for (uint j = 0; j < RAILTYPE_END; j++) delete caches[i][j];
+			}
+		}
+	};
+
+	inline static Cache& stGetGlobalCache(Owner owner, RailType railtype)
 	{
-		static int last_rail_change_counter = 0;
 		static Date last_date = 0;
-		static Cache C;
+		static Partitions partitions;
 
 		/* some statistics */
 		if (last_date != _date) {
@@ -198,12 +421,13 @@ protected:
 			_total_pf_time_us = 0;
 		}
 
-		/* delete the cache sometimes... */
-		if (last_rail_change_counter != Cache::s_rail_change_counter) {
-			last_rail_change_counter = Cache::s_rail_change_counter;
-			C.Flush();
-		}
-		return C;
+		assert(owner < MAX_COMPANIES && railtype < RAILTYPE_END);
+		Cache *&C = partitions.caches[owner][railtype];
+		if (C == NULL) C = new Cache(owner, railtype);
+
+		/* forget the segments the track layout changes affected and stay within the budget */
+		C->BeginRun((size_t)_settings_game.pf.yapf.rail_segment_cache_size << 10);
+		return *C;
 	}
 
 public:
@@ -216,9 +440,12 @@ public:
 		if (!Yapf().CanUseGlobalCache(n)) {
 			return Tlocal::PfNodeCacheFetch(n);
 		}
+		if (m_global_cache == NULL) {
+			m_global_cache = &stGetGlobalCache(Yapf().GetVehicle()->owner, Yapf().GetVehicle()->railtype);
+		}
 		CacheKey key(n.GetKey());
 		bool found;
-		CachedData& item = m_global_cache.Get(key, &found);
+		CachedData& item = m_global_cache->Get(key, &found);
 		Yapf().ConnectNodeToCachedData(n, item);
 		return found;
 	}
@@ -230,6 +457,15 @@ public:
 	inline void PfNodeCacheFlush(Node& n)
 	{
 	}
+
+	/**
+	 * Called by the cost calculation when it has calculated the cost of a globally
+	 *  cached segment, with the tiles whose track layout the cost depends on.
+	 */
+	inline void PfNodeCacheAddTiles(Node& n, const TileIndex *begin, const TileIndex *end)
+	{
+		m_global_cache->AddTiles(*n.m_segment, begin, end);
+	}
 };
 
 #endif /* YAPF_COSTCACHE_HPP */
@@ -67,6 +67,7 @@ protected:
 	int           m_max_cost;
 	CBlobT<int>   m_sig_look_ahead_costs;
 	bool          m_disable_cache;
+	SmallVector<TileIndex, 16> m_segment_tiles; ///< tiles the cost of the globally cached segment being calculated depends on
 
 public:
 	bool          m_stopped_on_first_two_way_signal;
@@ -295,6 +296,10 @@ public:
 		CachedData &segment = *n.m_segment;
 		bool is_cached_segment = (segment.m_cost >= 0);
 
+		/* Collect the tiles a newly calculated global segment depends on, so a change there invalidates it. */
+		bool register_tiles = !is_cached_segment && CanUseGlobalCache(n);
+		m_segment_tiles.Clear();
+
 		int parent_cost = has_parent ? n.m_parent->m_cost : 0;
 
 		/* Each node cost contains 2 or 3 main components:
@@ -385,6 +390,15 @@ public:
 
 no_entry_cost: // jump here at the beginning if the node has no parent (it is the first node)
 
+			if (register_tiles) {
+				*m_segment_tiles.Append() = cur.tile;
+				if (tf->m_is_station) {
+					/* The follower jumped over the platform; its length depends on all its tiles. */
+					TileIndexDiff diff = TileOffsByDiagDir(TrackdirToExitdir(cur.td));
+					for (int i = 1; i <= tf->m_tiles_skipped; i++) *m_segment_tiles.Append() = cur.tile - diff * i;
+				}
+			}
+
 			/* All other tile costs will be calculated here. */
 			segment_cost += Yapf().OneTileCost(cur.tile, cur.td);
 
@@ -490,6 +504,8 @@ no_entry_cost: // jump here at the beginning if the node has no parent (it is th
 
 			if (!tf_local.Follow(cur.tile, cur.td)) {
 				assert(tf_local.m_err != TrackFollower::EC_NONE);
+				/* Building track on the neighbour tile would let the segment continue. */
+				if (register_tiles) *m_segment_tiles.Append() = TileAddByDiagDir(cur.tile, TrackdirToExitdir(cur.td));
 				/* Can't move to the next tile (EOL?). */
 				if (tf_local.m_err == TrackFollower::EC_RAIL_TYPE) {
 					end_segment_reason |= ESRB_RAIL_TYPE;
@@ -503,6 +519,8 @@ no_entry_cost: // jump here at the beginning if the node has no parent (it is th
 				break;
 			}
 
+			if (register_tiles) *m_segment_tiles.Append() = tf_local.m_new_tile;
+
 			/* Check if the next tile is not a choice. */
 			if (KillFirstBit(tf_local.m_new_td_bits) != TRACKDIR_BIT_NONE) {
 				/* More than one segment will follow. Close this one. */
@@ -573,6 +591,7 @@ no_entry_cost: // jump here at the beginning if the node has no parent (it is th
 			segment.m_end_segment_reason = end_segment_reason & ESRB_CACHED_MASK;
 			/* Save end of segment back to the node. */
 			n.SetLastTileTrackdir(cur.tile, cur.td);
+			if (register_tiles) Yapf().PfNodeCacheAddTiles(n, m_segment_tiles.Begin(), m_segment_tiles.End());
 		}
 
 		/* Do we have an excuse why not to continue pathfinding in this direction? */
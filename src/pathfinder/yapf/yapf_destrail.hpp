@@ -163,6 +163,30 @@ public:
 		CYapfDestinationRailBase::SetDestination(v);
 	}
 
+	/**
+	 * Might the destination be reached from the given tile? Only looks at which
+	 *  tiles the track layout connects, so this can be true without a path.
+	 * @param v    the train
+	 * @param tile the tile the path starts at
+	 * @return false if there is certainly no path
+	 */
+	inline bool MightReachDestination(const Train *v, TileIndex tile)
+	{
+		if (m_dest_station_id != INVALID_STATION) {
+			TileArea ta;
+			BaseStation::Get(m_dest_station_id)->GetTileArea(&ta, v->current_order.IsType(OT_GOTO_STATION) ? STATION_RAIL : STATION_WAYPOINT);
+			TILE_AREA_LOOP(t, ta) {
+				if (HasStationTileRail(t) && GetStationIndex(t) == m_dest_station_id &&
+						_yapf_rail_connectivity.MightBeConnected(tile, t)) {
+					return true;
+				}
+			}
+			return false;
+		}
+		/* Only a depot is certainly the tile the path has to end at. */
+		return !v->current_order.IsType(OT_GOTO_DEPOT) || _yapf_rail_connectivity.MightBeConnected(tile, m_destTile);
+	}
+
 	/** Called by YAPF to detect if node ends in the desired destination */
 	inline bool PfDetectDestination(Node& n)
 	{
@@ -142,6 +142,7 @@ struct CYapfRailSegment
 	TileIndex              m_last_signal_tile;
 	Trackdir               m_last_signal_td;
 	EndSegmentReasonBits   m_end_segment_reason;
+	uint32                 m_last_use; ///< path finder run that used the segment last, for evicting it from the cache
 	CYapfRailSegment      *m_hash_next;
 
 	inline CYapfRailSegment(const CYapfRailSegmentKey& key)
@@ -152,9 +153,21 @@ struct CYapfRailSegment
 		, m_last_signal_tile(INVALID_TILE)
 		, m_last_signal_td(INVALID_TRACKDIR)
 		, m_end_segment_reason(ESRB_NONE)
+		, m_last_use(0)
 		, m_hash_next(NULL)
 	{}
 
+	/** Forget the cached cost, so it is calculated again when the segment is used next time. */
+	inline void Invalidate()
+	{
+		m_last_tile = INVALID_TILE;
+		m_last_td = INVALID_TRACKDIR;
+		m_cost = -1;
+		m_last_signal_tile = INVALID_TILE;
+		m_last_signal_td = INVALID_TRACKDIR;
+		m_end_segment_reason = ESRB_NONE;
+	}
+
 	inline const Key& GetKey() const
 	{
 		return m_key;
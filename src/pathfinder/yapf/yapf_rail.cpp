@@ -15,8 +15,10 @@
 #include "yapf_cache.h"
 #include "yapf_node_rail.hpp"
 #include "yapf_costrail.hpp"
+#include "yapf_connectivity.h"
 #include "yapf_destrail.hpp"
 #include "../../viewport_func.h"
+#include "../../console_func.h"
 
 #define DEBUG_YAPF_CACHE 0
 
@@ -431,6 +433,12 @@ public:
 		Yapf().SetOrigin(origin.tile, origin.trackdir, INVALID_TILE, INVALID_TRACKDIR, 1, true);
 		Yapf().SetDestination(v);
 
+		/* A lost train would search until running out of nodes each time; don't if the destination can't be reached at all. */
+		if (HasBit(v->vehicle_flags, VF_PATHFINDER_LOST) && !Yapf().MightReachDestination(v, origin.tile)) {
+			path_found = false;
+			return INVALID_TRACKDIR;
+		}
+
 		/* find the best path */
 		path_found = Yapf().FindPath(v);
 
@@ -644,9 +652,50 @@ bool YapfTrainFindNearestSafeTile(const Train *v, TileIndex tile, Trackdir td, b
 }
 
 /** if any track changes, this counter is incremented - that will invalidate segment cost cache */
-int CSegmentCostCacheBase::s_rail_change_counter = 0;
+uint CSegmentCostCacheBase::s_rail_change_counter = 0;
+/** the tiles of the most recent track layout changes */
+TileIndex CSegmentCostCacheBase::s_rail_changed_tiles[CSegmentCostCacheBase::C_CHANGE_LOG_SIZE];
+/** all rail segment cost caches that were created */
+SmallVector<CSegmentCostCacheBase *, 32> CSegmentCostCacheBase::s_caches;
 
 void YapfNotifyTrackLayoutChange(TileIndex tile, Track track)
 {
 	CSegmentCostCacheBase::NotifyTrackLayoutChange(tile, track);
+	_yapf_rail_connectivity.Notify(tile);
+}
+
+void YapfNotifyCompanyRemoved(Owner owner)
+{
+	CSegmentCostCacheBase::FlushCompany(owner);
+}
+
+void YapfPrintSegmentCacheStats()
+{
+	/* Each kind of rail path finder has its own caches; sum them per company and rail type. */
+	for (Owner owner = COMPANY_FIRST; owner < MAX_COMPANIES; owner++) {
+		for (RailType railtype = RAILTYPE_BEGIN; railtype < RAILTYPE_END; railtype++) {
+			uint caches = 0;
+			uint segments = 0;
+			size_t memory = 0;
+			uint64 hits = 0, misses = 0, evictions = 0, invalidations = 0;
+			uint flushes = 0;
+			for (CSegmentCostCacheBase **it = CSegmentCostCacheBase::s_caches.Begin(); it != CSegmentCostCacheBase::s_caches.End(); it++) {
+				const CSegmentCostCacheBase *cache = *it;
+				if (cache->m_owner != owner || cache->m_railtype != railtype) continue;
+				caches++;
+				segments += cache->m_segments;
+				memory += cache->m_memory;
+				hits += cache->m_hits;
+				misses += cache->m_misses;
+				evictions += cache->m_evictions;
+				invalidations += cache->m_invalidations;
+				flushes += cache->m_flushes;
+			}
+			if (caches == 0) continue;
+
+			IConsolePrintF(CC_DEFAULT, "Company %2d, rail type %2d: %u segments, %u KiB, " OTTD_PRINTF64 " hits, " OTTD_PRINTF64 " misses, "
+					OTTD_PRINTF64 " evictions, " OTTD_PRINTF64 " invalidations, %u flushes",
+					owner + 1, railtype, segments, (uint)(memory >> 10), hits, misses, evictions, invalidations, flushes);
+		}
+	}
 }
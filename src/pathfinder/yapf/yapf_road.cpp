@@ -12,7 +12,175 @@
 #include "../../stdafx.h"
 #include "yapf.hpp"
 #include "yapf_node_road.hpp"
+#include "yapf_connectivity.h"
 #include "../../roadstop_base.h"
+#include "../../core/mem_func.hpp"
+
+#include <map>
+#include <set>
+#include <vector>
+
+/**
+ * The result of a search of the road vehicle path finder, with the things it
+ *  depends on that aren't part of the key it's cached under.
+ */
+struct CYapfRoadRoute {
+	/** The cost of a road stop tile, which depends on how busy the stop is. */
+	struct StopCost {
+		TileIndex tile;    ///< the road stop tile
+		Trackdir trackdir; ///< the trackdir the cost is for
+		int cost;          ///< the cost of the tile
+	};
+
+	Trackdir trackdir;                ///< trackdir to take on the origin tile
+	bool path_found;                  ///< whether the destination was found
+	std::vector<StopCost> stop_costs; ///< costs of the road stop tiles the search passed
+	std::set<uint> areas;             ///< areas of the tiles the search looked at; only kept while searching
+	uint last_area;                   ///< area of the last tile added
+
+	CYapfRoadRoute() : trackdir(INVALID_TRACKDIR), path_found(false), last_area(UINT_MAX) {}
+
+	/** Get the area of the area index of the route cache a tile is in. */
+	static inline uint GetArea(TileIndex tile)
+	{
+		return ((TileY(tile) >> 3) << 16) | (TileX(tile) >> 3);
+	}
+
+	/** Remember that the search looked at the given tile. */
+	inline void AddTile(TileIndex tile)
+	{
+		uint area = GetArea(tile);
+		if (area == last_area) return;
+		areas.insert(area);
+		last_area = area;
+	}
+
+	/** Remember the cost of a road stop tile the search used. */
+	inline void AddStopCost(TileIndex tile, Trackdir td, int cost)
+	{
+		for (std::vector<StopCost>::const_iterator it = stop_costs.begin(); it != stop_costs.end(); ++it) {
+			if (it->tile == tile && it->trackdir == td) return;
+		}
+		StopCost sc = { tile, td, cost };
+		stop_costs.push_back(sc);
+	}
+};
+
+/**
+ * Cache of the results of the road vehicle path finder, shared by all road vehicles.
+ *  Vehicles of the same model heading from the same junction to the same destination
+ *  do the same search, so they can use the result of the first one.
+ *
+ * Every client must get the same result as a search would give, even when it just
+ *  joined with an empty cache. So a result is only used while nothing it depends on
+ *  changed: results are dropped when a tile in the area of a tile the search looked at
+ *  changes and when the path finder settings change, and the costs of the road stops
+ *  it passed, which change with the vehicles using them, are checked before using it.
+ */
+class CYapfRoadRouteCache {
+public:
+	/** Everything a search depends on besides the tiles it looked at. */
+	struct Key {
+		TileIndex tile;          ///< the origin tile
+		TileIndex dest_tile;     ///< the destination tile
+		StationID dest_station;  ///< the destination station, or INVALID_STATION
+		RoadTypes roadtypes;     ///< the road types the vehicle can drive on
+		Owner owner;             ///< the owner of the vehicle, for depots
+		DiagDirection enterdir;  ///< the direction the origin tile is entered in
+		bool bus;                ///< whether the vehicle is a bus
+		bool non_artic;          ///< whether the vehicle is not articulated
+		uint16 max_speed;        ///< the maximum speed of the vehicle
+
+		Key(const RoadVehicle *v, TileIndex tile, DiagDirection enterdir, TileIndex dest_tile, StationID dest_station) :
+				tile(tile), dest_tile(dest_tile), dest_station(dest_station), roadtypes(v->compatible_roadtypes), owner(v->owner),
+				enterdir(enterdir), bus(v->IsBus()), non_artic(!v->HasArticulatedPart()), max_speed(v->GetDisplayMaxSpeed())
+		{
+		}
+
+		bool operator < (const Key &other) const
+		{
+			if (this->tile != other.tile) return this->tile < other.tile;
+			if (this->dest_tile != other.dest_tile) return this->dest_tile < other.dest_tile;
+			if (this->dest_station != other.dest_station) return this->dest_station < other.dest_station;
+			if (this->roadtypes != other.roadtypes) return this->roadtypes < other.roadtypes;
+			if (this->owner != other.owner) return this->owner < other.owner;
+			if (this->enterdir != other.enterdir) return this->enterdir < other.enterdir;
+			if (this->bus != other.bus) return this->bus < other.bus;
+			if (this->non_artic != other.non_artic) return this->non_artic < other.non_artic;
+			return this->max_speed < other.max_speed;
+		}
+	};
+
+	/**
+	 * Find the result of an earlier search with the same key.
+	 * @param key the key of the search
+	 * @return the result; its road stop costs still have to be checked; NULL if there is none
+	 */
+	const CYapfRoadRoute *Find(const Key &key)
+	{
+		if (MemCmpT(&m_settings, &_settings_game.pf.yapf) != 0) Flush();
+		RouteMap::const_iterator it = m_routes.find(key);
+		return it == m_routes.end() ? NULL : &it->second;
+	}
+
+	/**
+	 * Store the result of a search.
+	 * @param key   the key of the search
+	 * @param route the result; its areas are consumed
+	 */
+	void Add(const Key &key, CYapfRoadRoute &route)
+	{
+		if (m_routes.size() >= C_MAX_ROUTES || m_areas.size() + route.areas.size() > C_MAX_AREA_ENTRIES) Flush();
+
+		for (std::set<uint>::const_iterator it = route.areas.begin(); it != route.areas.end(); ++it) {
+			m_areas.insert(std::make_pair(*it, key));
+		}
+
+		CYapfRoadRoute &stored = m_routes[key];
+		stored.trackdir = route.trackdir;
+		stored.path_found = route.path_found;
+		stored.stop_costs.swap(route.stop_costs);
+	}
+
+	/**
+	 * Drop the results of the searches that looked at a tile near the given tile.
+	 * @param tile the tile that changed, or INVALID_TILE to drop everything
+	 */
+	void Invalidate(TileIndex tile)
+	{
+		if (tile == INVALID_TILE) {
+			Flush();
+			return;
+		}
+
+		/* Results that were replaced or dropped through another area may leave stale
+		 * entries in the index; those drop a newer result at worst. */
+		std::pair<AreaIndex::iterator, AreaIndex::iterator> range = m_areas.equal_range(CYapfRoadRoute::GetArea(tile));
+		for (AreaIndex::iterator it = range.first; it != range.second; ++it) m_routes.erase(it->second);
+		m_areas.erase(range.first, range.second);
+	}
+
+private:
+	static const size_t C_MAX_ROUTES = 1 << 16;        ///< number of results before the cache is flushed
+	static const size_t C_MAX_AREA_ENTRIES = 1 << 18;  ///< number of area index entries before the cache is flushed
+
+	typedef std::map<Key, CYapfRoadRoute> RouteMap;
+	typedef std::multimap<uint, Key> AreaIndex;
+
+	RouteMap m_routes;       ///< the results of the searches
+	AreaIndex m_areas;       ///< the keys of the results that depend on a tile in each area
+	YAPFSettings m_settings; ///< the path finder settings the results were found with
+
+	/** Drop all results. */
+	void Flush()
+	{
+		m_routes.clear();
+		m_areas.clear();
+		MemCpyT(&m_settings, &_settings_game.pf.yapf);
+	}
+};
+
+static CYapfRoadRouteCache _yapf_road_route_cache; ///< results of the road vehicle path finder
 
 
 template <class Types>
@@ -25,6 +193,10 @@ public:
 	typedef typename Node::Key Key;    ///< key to hash tables
 
 protected:
+	CYapfRoadRoute *m_route; ///< the route to record what the search depends on in, or NULL
+
+	CYapfCostRoadT() : m_route(NULL) {}
+
 	/** to access inherited path finder */
 	Tpf& Yapf()
 	{
@@ -81,6 +253,7 @@ protected:
 						/* Increase cost for filled road stops */
 						cost += Yapf().PfGetSettings().road_stop_bay_occupied_penalty * (!rs->IsFreeBay(0) + !rs->IsFreeBay(1)) / 2;
 					}
+					if (m_route != NULL) m_route->AddStopCost(tile, trackdir, cost);
 					break;
 				}
 
@@ -95,6 +268,27 @@ protected:
 	}
 
 public:
+	/** Record the tiles the search looks at and the road stop costs it uses in the given route. */
+	inline void RecordRoute(CYapfRoadRoute *route)
+	{
+		m_route = route;
+	}
+
+	/** Remember that the search looked at the given tile, when recording a route. */
+	inline void RecordRouteTile(TileIndex tile)
+	{
+		if (m_route != NULL && tile != INVALID_TILE) m_route->AddTile(tile);
+	}
+
+	/** Do the road stop tiles a recorded route passed still cost the same? */
+	inline bool AreStopCostsUnchanged(const CYapfRoadRoute &route)
+	{
+		for (std::vector<CYapfRoadRoute::StopCost>::const_iterator it = route.stop_costs.begin(); it != route.stop_costs.end(); ++it) {
+			if (OneTileCost(it->tile, it->trackdir) != it->cost) return false;
+		}
+		return true;
+	}
+
 	/**
 	 * Called by YAPF to calculate the cost from the origin to the given node.
 	 *  Calculates only the cost of given node, adds it to the parent node cost
@@ -108,6 +302,8 @@ public:
 		TileIndex tile = n.m_key.m_tile;
 		Trackdir trackdir = n.m_key.m_td;
 		for (;;) {
+			RecordRouteTile(tile);
+
 			/* base tile cost depending on distance between edges */
 			segment_cost += Yapf().OneTileCost(tile, trackdir);
 
@@ -123,7 +319,9 @@ public:
 
 			/* if there are no reachable trackdirs on new tile, we have end of road */
 			TrackFollower F(Yapf().GetVehicle());
-			if (!F.Follow(tile, trackdir)) break;
+			bool followed = F.Follow(tile, trackdir);
+			RecordRouteTile(F.m_new_tile);
+			if (!followed) break;
 
 			/* if there are more trackdirs available & reachable, we are at the end of segment */
 			if (KillFirstBit(F.m_new_td_bits) != TRACKDIR_BIT_NONE) break;
@@ -221,6 +419,18 @@ protected:
 	bool         m_non_artic;
 
 public:
+	/** Get the tile the search heads for. */
+	inline TileIndex GetDestinationTile() const
+	{
+		return m_destTile;
+	}
+
+	/** Get the station the search heads for, or INVALID_STATION. */
+	inline StationID GetDestinationStation() const
+	{
+		return m_dest_station;
+	}
+
 	void SetDestination(const RoadVehicle *v)
 	{
 		if (v->current_order.IsType(OT_GOTO_STATION)) {
@@ -244,6 +454,31 @@ protected:
 	}
 
 public:
+	/**
+	 * Might the destination be reached from the given tile? Only looks at which
+	 *  tiles the road layout connects, so this can be true without a path.
+	 * @param v    the road vehicle
+	 * @param tile the tile the path starts at
+	 * @return false if there is certainly no path
+	 */
+	inline bool MightReachDestination(const RoadVehicle *v, TileIndex tile)
+	{
+		if (m_dest_station != INVALID_STATION) {
+			TileArea ta;
+			Station::Get(m_dest_station)->GetTileArea(&ta, m_bus ? STATION_BUS : STATION_TRUCK);
+			TILE_AREA_LOOP(t, ta) {
+				if (IsTileType(t, MP_STATION) && GetStationIndex(t) == m_dest_station &&
+						(m_bus ? IsBusStop(t) : IsTruckStop(t)) &&
+						_yapf_road_connectivity.MightBeConnected(tile, t)) {
+					return true;
+				}
+			}
+			return false;
+		}
+		/* Only a depot is certainly the tile the path has to end at. */
+		return !v->current_order.IsType(OT_GOTO_DEPOT) || _yapf_road_connectivity.MightBeConnected(tile, m_destTile);
+	}
+
 	/** Called by YAPF to detect if node ends in the desired destination */
 	inline bool PfDetectDestination(Node& n)
 	{
@@ -320,9 +555,9 @@ public:
 	inline void PfFollowNode(Node& old_node)
 	{
 		TrackFollower F(Yapf().GetVehicle());
-		if (F.Follow(old_node.m_segment_last_tile, old_node.m_segment_last_td)) {
-			Yapf().AddMultipleNodes(&old_node, F);
-		}
+		bool followed = F.Follow(old_node.m_segment_last_tile, old_node.m_segment_last_td);
+		Yapf().RecordRouteTile(F.m_new_tile);
+		if (followed) Yapf().AddMultipleNodes(&old_node, F);
 	}
 
 	/** return debug report character to identify the transportation type */
@@ -358,6 +593,25 @@ public:
 		Yapf().SetOrigin(src_tile, src_trackdirs);
 		Yapf().SetDestination(v);
 
+		/* A lost vehicle would search until running out of nodes each time; don't if the destination can't be reached at all. */
+		if (HasBit(v->vehicle_flags, VF_PATHFINDER_LOST) && !Yapf().MightReachDestination(v, src_tile)) {
+			path_found = false;
+			return INVALID_TRACKDIR;
+		}
+
+		/* Vehicles doing the same search get the same result, as long as the road stops on the way are as busy as before. */
+		CYapfRoadRouteCache::Key key(v, src_tile, enterdir, Yapf().GetDestinationTile(), Yapf().GetDestinationStation());
+		const CYapfRoadRoute *cached = _yapf_road_route_cache.Find(key);
+		if (cached != NULL && Yapf().AreStopCostsUnchanged(*cached)) {
+			PathfinderStatsAddCacheHits(1);
+			path_found = cached->path_found;
+			return cached->trackdir;
+		}
+
+		CYapfRoadRoute route;
+		route.AddTile(src_tile);
+		Yapf().RecordRoute(&route);
+
 		/* find the best path */
 		path_found = Yapf().FindPath(v);
 
@@ -375,6 +629,10 @@ public:
 			assert(best_next_node.GetTile() == tile);
 			next_trackdir = best_next_node.GetTrackdir();
 		}
+
+		route.trackdir = next_trackdir;
+		route.path_found = path_found;
+		_yapf_road_route_cache.Add(key, route);
 		return next_trackdir;
 	}
 
@@ -478,6 +736,17 @@ struct CYapfRoadAnyDepot1 : CYapfT<CYapfRoad_TypesT<CYapfRoadAnyDepot1, CRoadNod
 struct CYapfRoadAnyDepot2 : CYapfT<CYapfRoad_TypesT<CYapfRoadAnyDepot2, CRoadNodeListExitDir , CYapfDestinationAnyDepotRoadT> > {};
 
 
+void YapfNotifyRoadLayoutChange(TileIndex tile)
+{
+	_yapf_road_connectivity.Notify(tile);
+	_yapf_road_route_cache.Invalidate(tile);
+}
+
+void YapfNotifyRoadCostChange(TileIndex tile)
+{
+	_yapf_road_route_cache.Invalidate(tile);
+}
+
 Trackdir YapfRoadVehicleChooseTrack(const RoadVehicle *v, TileIndex tile, DiagDirection enterdir, TrackdirBits trackdirs, bool &path_found)
 {
 	/* default is YAPF type 2 */
@@ -14,6 +14,7 @@
 #include "command_func.h"
 #include "news_func.h"
 #include "pathfinder/npf/npf_func.h"
+#include "pathfinder/pf_stats.h"
 #include "station_base.h"
 #include "company_func.h"
 #include "vehicle_gui.h"
@@ -326,6 +327,7 @@ static FindDepotData FindClosestRoadDepot(const RoadVehicle *v, int max_distance
 {
 	if (IsRoadDepotTile(v->tile)) return FindDepotData(v->tile, 0);
 
+	PathfinderCallTimer timer(v, _settings_game.pf.pathfinder_for_roadvehs);
 	switch (_settings_game.pf.pathfinder_for_roadvehs) {
 		case VPF_NPF: return NPFRoadVehicleFindNearestDepot(v, max_distance);
 		case VPF_YAPF: return YapfRoadVehicleFindNearestDepot(v, max_distance);
@@ -928,11 +930,14 @@ static Trackdir RoadFindPathToDest(RoadVehicle *v, TileIndex tile, DiagDirection
 		return_track(FindFirstBit2x64(trackdirs));
 	}
 
-	switch (_settings_game.pf.pathfinder_for_roadvehs) {
-		case VPF_NPF:  best_track = NPFRoadVehicleChooseTrack(v, tile, enterdir, trackdirs, path_found); break;
-		case VPF_YAPF: best_track = YapfRoadVehicleChooseTrack(v, tile, enterdir, trackdirs, path_found); break;
+	{
+		PathfinderCallTimer timer(v, _settings_game.pf.pathfinder_for_roadvehs);
+		switch (_settings_game.pf.pathfinder_for_roadvehs) {
+			case VPF_NPF:  best_track = NPFRoadVehicleChooseTrack(v, tile, enterdir, trackdirs, path_found); break;
+			case VPF_YAPF: best_track = YapfRoadVehicleChooseTrack(v, tile, enterdir, trackdirs, path_found); break;
 
-		default: NOT_REACHED();
+			default: NOT_REACHED();
+		}
 	}
 	v->HandlePathfindingResult(path_found);
 
@@ -1219,6 +1219,7 @@ bool AfterLoadGame()
 	}
 
 	YapfNotifyTrackLayoutChange(INVALID_TILE, INVALID_TRACK);
+	YapfNotifyRoadLayoutChange(INVALID_TILE);
 
 	if (IsSavegameVersionBefore(34)) {
 		Company *c;
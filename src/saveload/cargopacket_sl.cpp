@@ -109,6 +109,10 @@ const SaveLoad *GetCargoPacketDesc()
  */
 static void Save_CAPA()
 {
+	/* Save the actual days in transit of the cargo in vehicles. */
+	Vehicle *v;
+	FOR_ALL_VEHICLES(v) v->cargo.ApplyPendingAge();
+
 	CargoPacket *cp;
 
 	FOR_ALL_CARGOPACKETS(cp) {
@@ -18,6 +18,8 @@
 
 const SettingDesc *GetSettingDescription(uint index);
 
+static uint32 _num_signatures;
+
 /**
  * Get a SaveLoad array for a link graph. The settings struct is derived from
  * the global settings saveload array. The exact entries are calculated when the function
@@ -57,6 +59,8 @@ const SaveLoad *GetLinkGraphDesc()
 			SLE_CONDVAR(LinkGraph, index,              SLE_UINT16, SL_COMPONENTS, SL_MAX_VERSION),
 			SLE_CONDVAR(LinkGraph, current_station_id, SLE_UINT16, SL_COMPONENTS, SL_MAX_VERSION),
 			SLE_CONDVAR(LinkGraph, cargo,              SLE_UINT8,  SL_COMPONENTS, SL_MAX_VERSION),
+			SLE_CONDVAR(LinkGraph, join_date,          SLE_INT32,   SL_JOIN_DATE, SL_MAX_VERSION),
+			SLEG_CONDVAR(_num_signatures,              SLE_UINT32,  SL_COMPONENT_SIGNATURES, SL_MAX_VERSION),
 			SLE_END()
 		};
 
@@ -69,15 +73,23 @@ const SaveLoad *GetLinkGraphDesc()
 	return &saveloads[0];
 }
 
-/* Edges and nodes are saved in the correct order, so we don't need to save their ids. */
+/* Nodes are saved in the correct order, so we don't need to save their ids.
+ * Before SL_SPARSE_GRAPH the edges were saved as a complete matrix, with the
+ * links chained via next_edge. Since then only the links are saved, each
+ * node's links following the node itself. */
+
+static uint32 _num_edges;
+static NodeID _next_edge;
 
 /**
  * SaveLoad desc for a link graph node.
  */
 static const SaveLoad _node_desc[] = {
-	 SLE_CONDVAR(Node, supply,    SLE_UINT32, SL_COMPONENTS, SL_MAX_VERSION),
-	 SLE_CONDVAR(Node, demand,    SLE_UINT32, SL_COMPONENTS, SL_MAX_VERSION),
-	 SLE_CONDVAR(Node, station,   SLE_UINT16, SL_COMPONENTS, SL_MAX_VERSION),
+	 SLE_CONDVAR(Node, supply,    SLE_UINT32,   SL_COMPONENTS, SL_MAX_VERSION),
+	 SLE_CONDVAR(Node, demand,    SLE_UINT32,   SL_COMPONENTS, SL_MAX_VERSION),
+	 SLE_CONDVAR(Node, station,   SLE_UINT16,   SL_COMPONENTS, SL_MAX_VERSION),
+	 SLE_CONDVAR(Node, xy,        SLE_UINT32, SL_SPARSE_GRAPH, SL_MAX_VERSION),
+	SLEG_CONDVAR(_num_edges,      SLE_UINT32, SL_SPARSE_GRAPH, SL_MAX_VERSION),
 	 SLE_END()
 };
 
@@ -85,28 +97,100 @@ static const SaveLoad _node_desc[] = {
  * SaveLoad desc for a link graph edge.
  */
 static const SaveLoad _edge_desc[] = {
-	 SLE_CONDVAR(Edge, distance,  SLE_UINT32, SL_COMPONENTS, SL_MAX_VERSION),
-	 SLE_CONDVAR(Edge, capacity,  SLE_UINT32, SL_COMPONENTS, SL_MAX_VERSION),
-	 SLE_CONDVAR(Edge, next_edge, SLE_UINT32,        SL_MCF, SL_MAX_VERSION),
+	 SLE_CONDVAR(Edge, to,        SLE_UINT32, SL_SPARSE_GRAPH, SL_MAX_VERSION),
+	SLE_CONDNULL(4,                             SL_COMPONENTS, SL_SPARSE_GRAPH - 1), // distance
+	 SLE_CONDVAR(Edge, capacity,  SLE_UINT32,   SL_COMPONENTS, SL_MAX_VERSION),
+	SLEG_CONDVAR(_next_edge,      SLE_UINT32,          SL_MCF, SL_SPARSE_GRAPH - 1),
+	 SLE_END()
+};
+
+static StationID _signature_station;
+static uint64 _signature;
+
+/**
+ * SaveLoad desc for the signature of a component calculated before.
+ */
+static const SaveLoad _signature_desc[] = {
+	SLEG_CONDVAR(_signature_station, SLE_UINT16, SL_COMPONENT_SIGNATURES, SL_MAX_VERSION),
+	SLEG_CONDVAR(_signature,         SLE_UINT64, SL_COMPONENT_SIGNATURES, SL_MAX_VERSION),
 	 SLE_END()
 };
 
 /**
- * Save/load a component of a link graph
- * @param comp the component to be saved or loaded
+ * Save a component of a link graph.
+ * @param comp the component to be saved
  */
-static void SaveLoad_LinkGraphComponent(LinkGraphComponent &comp)
+static void Save_LinkGraphComponent(LinkGraphComponent &comp)
 {
 	uint size = comp.GetSize();
 	for (NodeID from = 0; from < size; ++from) {
-		Node *node = &comp.GetNode(from);
-		SlObject(node, _node_desc);
+		_num_edges = comp.GetNumEdges(from);
+		SlObject(&comp.GetNode(from), _node_desc);
+		LinkGraphComponent::EdgeIterator end = comp.GetEdgesEnd(from);
+		for (LinkGraphComponent::EdgeIterator i = comp.GetFirstEdge(from); i != end; ++i) {
+			SlObject(&(*i), _edge_desc);
+		}
+	}
+}
+
+/**
+ * Load the edge matrix of a node saved before SL_SPARSE_GRAPH and add the
+ * links found in it to the component.
+ * @param comp the component to be loaded
+ * @param from the node the edges start at
+ */
+static void Load_LinkGraphEdgeMatrix(LinkGraphComponent &comp, NodeID from)
+{
+	uint size = comp.GetSize();
+	std::vector<Edge> row(size);
+	std::vector<NodeID> next(size, INVALID_NODE);
+	for (NodeID to = 0; to < size; ++to) {
+		_next_edge = INVALID_NODE;
+		row[to].Init(to);
+		SlObject(&row[to], _edge_desc);
+		next[to] = _next_edge;
+	}
+
+	if (IsSavegameVersionBefore(SL_MCF)) {
+		/* There was no chain of links, yet. Anything with capacity is a link. */
 		for (NodeID to = 0; to < size; ++to) {
-			SlObject(&comp.GetEdge(from, to), _edge_desc);
+			if (to != from && row[to].capacity > 0) comp.AddEdge(from, to, row[to].capacity);
+		}
+	} else {
+		for (NodeID to = next[from]; to != INVALID_NODE; to = next[to]) {
+			comp.AddEdge(from, to, row[to].capacity);
 		}
 	}
 }
 
+/**
+ * Load a component of a link graph.
+ * @param comp the component to be loaded
+ */
+static void Load_LinkGraphComponent(LinkGraphComponent &comp)
+{
+	uint size = comp.GetSize();
+	for (NodeID from = 0; from < size; ++from) {
+		Node &node = comp.GetNode(from);
+		SlObject(&node, _node_desc);
+		node.undelivered_supply = node.supply;
+		if (IsSavegameVersionBefore(SL_SPARSE_GRAPH)) {
+			/* Stations are loaded before link graphs, so we can get the location from there. */
+			const Station *st = Station::GetIfValid(node.station);
+			node.xy = (st != NULL) ? st->xy : 0;
+			Load_LinkGraphEdgeMatrix(comp, from);
+		} else {
+			Edge edge;
+			for (uint32 i = 0; i < _num_edges; ++i) {
+				edge.Init();
+				SlObject(&edge, _edge_desc);
+				comp.AddEdge(from, edge.to, edge.capacity);
+			}
+		}
+	}
+	comp.CompressEdges();
+}
+
 /**
  * Save all link graphs.
  */
@@ -114,8 +198,15 @@ static void DoSave_LGRP(void *)
 {
 	for (CargoID cargo = 0; cargo < NUM_CARGO; ++cargo) {
 		LinkGraph &graph = _link_graphs[cargo];
+		LinkGraph::SignatureMap &signatures = graph.GetSignatures();
+		_num_signatures = (uint32)signatures.size();
 		SlObject(&graph, GetLinkGraphDesc());
-		SaveLoad_LinkGraphComponent(graph);
+		Save_LinkGraphComponent(graph);
+		for (LinkGraph::SignatureMap::iterator i = signatures.begin(); i != signatures.end(); ++i) {
+			_signature_station = i->first;
+			_signature = i->second;
+			SlObject(NULL, _signature_desc);
+		}
 	}
 }
 
@@ -127,25 +218,30 @@ static void Load_LGRP()
 	for (CargoID cargo = 0; cargo < NUM_CARGO; ++cargo) {
 		LinkGraph &graph = _link_graphs[cargo];
 		assert(graph.GetSize() == 0);
+		_num_signatures = 0;
 		SlObject(&graph, GetLinkGraphDesc());
 		graph.SetSize();
-		SaveLoad_LinkGraphComponent(graph);
-		for (uint i = 0; i < graph.GetSize(); ++i) {
-			Node &node = graph.GetNode(i);
-			node.undelivered_supply = node.supply;
+		Load_LinkGraphComponent(graph);
+		LinkGraph::SignatureMap &signatures = graph.GetSignatures();
+		for (uint32 i = 0; i < _num_signatures; ++i) {
+			SlObject(NULL, _signature_desc);
+			signatures[_signature_station] = _signature;
 		}
 	}
 }
 
 /**
- * Spawn the threads for running link graph calculations.
+ * Spawn the jobs for running link graph calculations.
  * Has to be done after loading as the cargo classes might have changed.
  */
 void AfterLoadLinkGraphs()
 {
 	for (CargoID cargo = 0; cargo < NUM_CARGO; ++cargo) {
 		LinkGraph &graph = _link_graphs[cargo];
-		if (graph.GetSize() > 0) graph.SpawnThread();
+		if (graph.GetSize() == 0) continue;
+		/* Older games joined jobs after recalc_interval days. */
+		if (IsSavegameVersionBefore(SL_JOIN_DATE)) graph.SetJoinDate(graph.GetSettings().recalc_interval);
+		graph.Spawn();
 	}
 }
 
@@ -234,7 +234,7 @@
  *  167   23504
  *  168   23637
  */
-extern const uint16 SAVEGAME_VERSION = SL_EXT_RATING; ///< Current savegame version of OpenTTD.
+extern const uint16 SAVEGAME_VERSION = SL_CARGO_TRUNCATION; ///< Current savegame version of OpenTTD.
 
 SavegameType _savegame_type; ///< type of savegame we are loading
 
@@ -557,6 +557,13 @@ enum SaveLoadVersions {
 	SL_FLOWMAP,
 	SL_CARGOMAP,
 	SL_EXT_RATING,
+	SL_SPARSE_GRAPH,
+	SL_JOIN_DATE,
+	SL_COMPONENT_SIGNATURES,
+	SL_MCF_ROUNDS,
+	SL_CLUSTERS,
+	SL_ROUTE_DISTANCES,
+	SL_CARGO_TRUNCATION,
 
 	/** Highest possible savegame version. */
 	SL_MAX_VERSION = 255
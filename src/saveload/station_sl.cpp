@@ -264,16 +264,18 @@ std::list<CargoPacket *> _packets;
 uint32 _num_dests;
 
 struct FlowSaveLoad {
-	FlowSaveLoad() : via(0), share(0) {}
+	FlowSaveLoad() : via(0), share(0), distance(0) {}
 	StationID source;
 	StationID via;
 	uint32 share;
+	uint32 distance;
 };
 
 static const SaveLoad _flow_desc[] = {
 	SLE_CONDVAR(FlowSaveLoad, source,             SLE_UINT16,         SL_FLOWMAP, SL_MAX_VERSION),
 	SLE_CONDVAR(FlowSaveLoad, via,                SLE_UINT16,         SL_FLOWMAP, SL_MAX_VERSION),
 	SLE_CONDVAR(FlowSaveLoad, share,              SLE_UINT32,         SL_FLOWMAP, SL_MAX_VERSION),
+	SLE_CONDVAR(FlowSaveLoad, distance,           SLE_UINT32, SL_ROUTE_DISTANCES, SL_MAX_VERSION),
 	SLE_END()
 };
 
@@ -504,11 +506,12 @@ static void RealSave_STNN(BaseStation *bst)
 				SlObject(&ls, GetLinkStatDesc());
 			}
 			for (FlowStatMap::const_iterator outer_it(st->goods[i].flows.begin()); outer_it != st->goods[i].flows.end(); ++outer_it) {
-				const FlowStat::SharesMap *shares = outer_it->second.GetShares();
+				const FlowStat::SharesVector *shares = outer_it->second.GetShares();
 				uint32 sum_shares = 0;
 				FlowSaveLoad flow;
 				flow.source = outer_it->first;
-				for (FlowStat::SharesMap::const_iterator inner_it(shares->begin()); inner_it != shares->end(); ++inner_it) {
+				flow.distance = outer_it->second.GetDistance();
+				for (FlowStat::SharesVector::const_iterator inner_it(shares->begin()); inner_it != shares->end(); ++inner_it) {
 					flow.via = inner_it->second;
 					flow.share = inner_it->first - sum_shares;
 					sum_shares = inner_it->first;
@@ -573,6 +576,7 @@ static void Load_STNN()
 					SlObject(&flow, _flow_desc);
 					if (fs == NULL || prev_source != flow.source) {
 						fs = &(st->goods[i].flows.insert(std::make_pair(flow.source, FlowStat(flow.via, flow.share))).first->second);
+						fs->SetDistance(flow.distance);
 					} else {
 						fs->AddShare(flow.via, flow.share);
 					}
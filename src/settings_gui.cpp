@@ -1415,6 +1415,7 @@ static SettingEntry _settings_stations[] = {
 	SettingEntry("station.station_spread"),
 	SettingEntry("economy.station_noise_level"),
 	SettingEntry("station.modified_catchment"),
+	SettingEntry("station.cargo_truncation"),
 	SettingEntry("construction.road_stop_on_town_road"),
 	SettingEntry("construction.road_stop_on_competitor_road"),
 };
@@ -1475,6 +1476,10 @@ static SettingEntry _settings_linkgraph[] = {
 	SettingEntry("linkgraph.demand_distance"),
 	SettingEntry("linkgraph.demand_size"),
 	SettingEntry("linkgraph.short_path_saturation"),
+	SettingEntry("linkgraph.max_mcf_rounds"),
+	SettingEntry("linkgraph.cluster_size"),
+	SettingEntry("linkgraph.job_speed"),
+	SettingEntry("linkgraph.recalc_tolerance"),
 };
 /** Linkgraph sub-page */
 static SettingsPage _settings_linkgraph_page = {_settings_linkgraph, lengthof(_settings_linkgraph)};
@@ -344,6 +344,8 @@ struct YAPFSettings {
 	uint32 rail_longer_platform_per_tile_penalty;  ///< penalty for longer  station platform than train (per tile)
 	uint32 rail_shorter_platform_penalty;          ///< penalty for shorter station platform than train
 	uint32 rail_shorter_platform_per_tile_penalty; ///< penalty for shorter station platform than train (per tile)
+
+	uint32 rail_segment_cache_size;                ///< memory budget of each rail segment cost cache in KiB
 };
 
 /** Settings related to all pathfinders. */
@@ -363,6 +365,7 @@ struct PathfinderSettings {
 	bool   reserve_paths;                    ///< always reserve paths regardless of signal type.
 	byte   wait_for_pbs_path;                ///< how long to wait for a path reservation.
 	byte   path_backoff_interval;            ///< ticks between checks for a free path.
+	bool   collect_statistics;               ///< measure the path finder calls for the pf_stats console command.
 
 	OPFSettings  opf;                        ///< pathfinder settings for the old pathfinder
 	NPFSettings  npf;                        ///< pathfinder settings for the new pathfinder
@@ -437,6 +440,10 @@ struct LinkGraphSettings {
 	uint8 demand_size;                          ///< influence of supply ("station size") on the demand function
 	uint8 demand_distance;                      ///< influence of distance between stations on the demand function
 	uint8 short_path_saturation;                ///< percentage up to which short paths are saturated before saturating most capacious paths
+	uint8 max_mcf_rounds;                       ///< maximum number of rounds of flow assignment in each pass of MCF; 0 for no limit
+	uint16 cluster_size;                        ///< number of nodes in the clusters big components are decomposed into; 0 to never decompose components
+	uint16 job_speed;                           ///< expected speed of link graph calculations in thousands of nodes * (nodes + links) per day; determines when jobs are joined
+	uint8 recalc_tolerance;                     ///< percentage by which supply and capacities may change before a component is recalculated
 
 	inline DistributionType GetDistributionType(CargoID cargo) const {
 		if (IsCargoInClass(cargo, CC_PASSENGERS)) {
@@ -458,6 +465,7 @@ struct StationSettings {
 	bool   distant_join_stations;            ///< allow to join non-adjacent stations
 	bool   never_expire_airports;            ///< never expire airports
 	byte   station_spread;                   ///< amount a station may spread
+	byte   cargo_truncation;                 ///< policy for choosing the cargo to remove from stations with too much cargo waiting; see CargoTruncationPolicy
 };
 
 /** Default settings for vehicles. */
@@ -16,6 +16,7 @@
 #include "news_func.h"
 #include "company_func.h"
 #include "pathfinder/npf/npf_func.h"
+#include "pathfinder/pf_stats.h"
 #include "depot_base.h"
 #include "station_base.h"
 #include "vehicle_gui.h"
@@ -395,6 +396,7 @@ static Track ChooseShipTrack(Ship *v, TileIndex tile, DiagDirection enterdir, Tr
 
 	bool path_found = true;
 	Track track;
+	PathfinderCallTimer timer(v, _settings_game.pf.pathfinder_for_ships);
 	switch (_settings_game.pf.pathfinder_for_ships) {
 		case VPF_OPF: track = OPFShipChooseTrack(v, tile, enterdir, tracks, path_found); break;
 		case VPF_NPF: track = NPFShipChooseTrack(v, tile, enterdir, tracks, path_found); break;
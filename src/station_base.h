@@ -13,6 +13,7 @@
 #define STATION_BASE_H
 
 #include "core/random_func.hpp"
+#include "core/flatmap_type.hpp"
 #include "base_station_base.h"
 #include "newgrf_airport.h"
 #include "cargopacket.h"
@@ -153,21 +154,22 @@ public:
 
 /**
  * Flow statistics telling how much flow should be sent along a link. This is
- * done by creating "flow shares" and using std::map's upper_bound() method to
- * look them up with a random number. A flow share is the difference between a
- * key in a map and the previous key. So one key in the map doesn't actually
- * mean anything by itself.
+ * done by creating "flow shares" and looking them up with a random number by
+ * binary search. The shares are kept in a vector of (cumulative share, station)
+ * pairs, sorted by cumulative share. A flow share is the difference between a
+ * cumulative share and the previous one. So one cumulative share doesn't
+ * actually mean anything by itself.
  */
 class FlowStat {
 public:
-	typedef std::map<uint32, StationID> SharesMap;
+	typedef std::vector<std::pair<uint32, StationID> > SharesVector;
 
 	inline FlowStat() {NOT_REACHED();}
-	
-	inline FlowStat(StationID st, uint flow)
+
+	inline FlowStat(StationID st, uint flow) : distance(0)
 	{
 		assert(flow > 0);
-		this->shares[flow] = st;
+		this->shares.push_back(std::make_pair(flow, st));
 	}
 
 	/**
@@ -178,36 +180,71 @@ public:
 	inline void AddShare(StationID st, uint flow)
 	{
 		assert(flow > 0);
-		this->shares[(--this->shares.end())->first + flow] = st;
+		this->shares.push_back(std::make_pair(this->shares.back().first + flow, st));
 	}
-	
+
 	uint GetShare(StationID st) const;
-	
+
 	void EraseShare(StationID st);
-	
-	inline const SharesMap *GetShares() const {return &this->shares;}
+
+	inline const SharesVector *GetShares() const {return &this->shares;}
+
+	/**
+	 * Get the distance the cargo is expected to travel from here until it's
+	 * delivered, averaged over the planned routes.
+	 * @return Distance in tiles or 0 if it isn't known.
+	 */
+	inline uint GetDistance() const {return this->distance;}
+
+	/**
+	 * Set the distance the cargo is expected to travel from here.
+	 * @param distance Distance in tiles.
+	 */
+	inline void SetDistance(uint distance) {this->distance = distance;}
 
 	/**
 	 * Get a station a package can be routed to. This done by drawing a
-	 * random number between 0 and sum_shares and then looking that up in 
-	 * the map with lower_bound. So each share gets selected with a
+	 * random number between 0 and sum_shares and then looking that up in
+	 * the shares with binary search. So each share gets selected with a
 	 * probability dependent on its flow.
-         * @return A station ID from the shares map.
-         */
+	 * @return A station ID from the shares.
+	 */
 	inline StationID GetVia() const
 	{
 		assert(!this->shares.empty());
-		return this->shares.upper_bound(RandomRange((--this->shares.end())->first - 1))->second;
+		return this->FindShare(RandomRange(this->shares.back().first - 1))->second;
 	}
 
 	StationID GetVia(StationID excluded) const;
 
 private:
-	SharesMap shares;  ///< Shares of flow to be sent via specified station (or consumed locally).
+	SharesVector shares;  ///< Shares of flow to be sent via specified station (or consumed locally).
+	uint distance;        ///< Mean distance of the planned routes from here to the cargo's destinations.
+
+	/**
+	 * Compare a value with the cumulative share of a pair of shares.
+	 * @param value Value to be compared.
+	 * @param share Share to be compared.
+	 * @return If value is lower than the share.
+	 */
+	static inline bool ShareGreater(uint32 value, const SharesVector::value_type &share)
+	{
+		return value < share.first;
+	}
+
+	/**
+	 * Find the share a value falls into.
+	 * @param value Value between 0 and the sum of all shares.
+	 * @return First share with a cumulative share greater than value.
+	 */
+	inline SharesVector::const_iterator FindShare(uint32 value) const
+	{
+		return std::upper_bound(this->shares.begin(), this->shares.end(), value, &FlowStat::ShareGreater);
+	}
 };
 
 typedef std::map<StationID, LinkStat> LinkStatMap;
-typedef std::map<StationID, FlowStat> FlowStatMap; ///< Flow descriptions by origin stations.
+typedef FlatMap<StationID, FlowStat> FlowStatMap; ///< Flow descriptions by origin stations.
 
 uint GetMovingAverageLength(const Station *from, const Station *to);
 
@@ -258,6 +295,17 @@ struct GoodsEntry {
 		FlowStatMap::const_iterator flow_it(this->flows.find(source));
 		return flow_it != this->flows.end() ? flow_it->second.GetVia(excluded) : INVALID_STATION;
 	}
+
+	/**
+	 * Get the distance cargo from a station is expected to travel from here.
+	 * @param source Station the cargo comes from.
+	 * @return Distance in tiles or 0 if it isn't known.
+	 */
+	inline uint GetRouteDistance(StationID source) const
+	{
+		FlowStatMap::const_iterator flow_it(this->flows.find(source));
+		return flow_it != this->flows.end() ? flow_it->second.GetDistance() : 0;
+	}
 };
 
 /** All airport-related information. Only valid if tile != INVALID_TILE. */
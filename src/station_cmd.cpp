@@ -52,6 +52,7 @@
 #include "order_backup.h"
 #include "newgrf_house.h"
 #include "company_gui.h"
+#include "linkgraph/linkgraph.h"
 
 #include "table/strings.h"
 
@@ -1276,10 +1277,10 @@ CommandCost CmdBuildRailStation(TileIndex tile_org, DoCommandFlag flags, uint32
 					TriggerStationAnimation(st, tile, SAT_BUILT);
 				}
 
+				YapfNotifyTrackLayoutChange(tile, track);
 				tile += tile_delta;
 			} while (--w);
 			AddTrackToSignalBuffer(tile_org, track, _current_company);
-			YapfNotifyTrackLayoutChange(tile_org, track);
 			tile_org += tile_delta ^ TileDiffXY(1, 1); // perpendicular to tile_delta
 		} while (--numtracks);
 
@@ -1820,6 +1821,7 @@ CommandCost CmdBuildRoadStop(TileIndex tile, DoCommandFlag flags, uint32 p1, uin
 			DirtyCompanyInfrastructureWindows(st->owner);
 
 			MarkTileDirtyByTile(cur_tile);
+			YapfNotifyRoadLayoutChange(cur_tile);
 		}
 	}
 
@@ -1922,6 +1924,7 @@ static CommandCost RemoveRoadStop(TileIndex tile, DoCommandFlag flags)
 		} else {
 			DoClearSquare(tile);
 		}
+		YapfNotifyRoadLayoutChange(tile);
 
 		SetWindowWidgetDirty(WC_STATION_VIEW, st->index, WID_SV_ROADVEHS);
 		delete cur_stop;
@@ -3254,7 +3257,7 @@ static void UpdateStationRating(Station *st)
 					 * decrease the flow of incoming cargo. */
 
 					StationCargoAmountMap waiting_per_source;
-					ge->cargo.CountAndTruncate(waiting, waiting_per_source);
+					ge->cargo.CountAndTruncate(waiting, waiting_per_source, (CargoTruncationPolicy)_settings_game.station.cargo_truncation);
 					for (StationCargoAmountMap::iterator i(waiting_per_source.begin()); i != waiting_per_source.end(); ++i) {
 						Station *source_station = Station::GetIfValid(i->first);
 						if (source_station == NULL) continue;
@@ -3291,7 +3294,7 @@ void DeleteStaleFlows(StationID at, CargoID c_id, StationID to)
 		FlowStat &s_flows = f_it->second;
 		s_flows.EraseShare(to);
 		if (s_flows.GetShares()->empty()) {
-			flows.erase(f_it++);
+			f_it = flows.erase(f_it);
 		} else {
 			++f_it;
 		}
@@ -3337,6 +3340,8 @@ void Station::RunAverages()
 
 		if (_settings_game.linkgraph.GetDistributionType(goods_index) == DT_MANUAL) {
 			this->goods[goods_index].flows.clear();
+			/* The flows are gone, so the components have to be calculated again. */
+			_link_graphs[goods_index].ClearSignatures();
 		}
 	}
 }
@@ -3459,7 +3464,10 @@ static uint UpdateStationWaiting(Station *st, CargoID type, uint amount, SourceT
 {
 	/* We can't allocate a CargoPacket? Then don't do anything
 	 * at all; i.e. just discard the incoming cargo. */
-	if (!CargoPacket::CanAllocateItem()) return 0;
+	if (!CargoPacket::CanAllocateItem()) {
+		_cargopacket_pool_stats.dropped_cargo += (amount + st->goods[type].amount_fract) >> 8;
+		return 0;
+	}
 
 	GoodsEntry &ge = st->goods[type];
 	amount += ge.amount_fract;
@@ -3878,7 +3886,7 @@ static CommandCost TerraformTile_Station(TileIndex tile, DoCommandFlag flags, in
 uint FlowStat::GetShare(StationID st) const
 {
 	uint32 prev = 0;
-	for (SharesMap::const_iterator it = this->shares.begin(); it != this->shares.end(); ++it) {
+	for (SharesVector::const_iterator it = this->shares.begin(); it != this->shares.end(); ++it) {
 		if (it->second == st) {
 			return it->first - prev;
 		} else {
@@ -3893,11 +3901,11 @@ uint FlowStat::GetShare(StationID st) const
  * @param excluded StationID not to be selected.
  * @return A station ID from the shares map.
  */
-inline StationID FlowStat::GetVia(StationID excluded) const
+StationID FlowStat::GetVia(StationID excluded) const
 {
 	assert(!this->shares.empty());
-	uint max = (--this->shares.end())->first - 1;
-	SharesMap::const_iterator it = this->shares.upper_bound(RandomRange(max));
+	uint max = this->shares.back().first - 1;
+	SharesVector::const_iterator it = this->FindShare(RandomRange(max));
 	assert(it != this->shares.end());
 	if (it->second != excluded) {
 		return it->second;
@@ -3907,9 +3915,9 @@ inline StationID FlowStat::GetVia(StationID excluded) const
 		uint begin = (it == this->shares.begin() ? 0 : (--it)->first);
 		uint rand = RandomRange(max - (end - begin));
 		if (rand < begin) {
-			return this->shares.upper_bound(rand)->second;
+			return this->FindShare(rand)->second;
 		} else {
-			return this->shares.upper_bound(rand + (end - begin))->second;
+			return this->FindShare(rand + (end - begin))->second;
 		}
 	}
 }
@@ -3922,19 +3930,19 @@ void FlowStat::EraseShare(StationID st)
 {
 	uint32 removed_shares = 0;
 	uint32 last_share = 0;
-	SharesMap new_shares;
-	for (SharesMap::iterator it(this->shares.begin()); it != this->shares.end(); ++it) {
+	SharesVector::iterator dest = this->shares.begin();
+	for (SharesVector::iterator it(this->shares.begin()); it != this->shares.end(); ++it) {
+		uint32 share = it->first;
 		if (it->second == st) {
-			removed_shares += it->first - last_share;
+			removed_shares += share - last_share;
 		} else {
-			new_shares[it->first - removed_shares] = it->second;
+			dest->first = share - removed_shares;
+			dest->second = it->second;
+			++dest;
 		}
-		last_share = it->first;
-	}
-	this->shares.swap(new_shares);
-	for (SharesMap::iterator it(this->shares.begin()); it != this->shares.end(); ++it) {
-		assert(it->second != st);
+		last_share = share;
 	}
+	this->shares.erase(dest, this->shares.end());
 }
 
 /**
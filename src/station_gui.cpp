@@ -1300,8 +1300,8 @@ struct StationViewWindow : public Window {
 		for (FlowStatMap::const_iterator it = flows.begin(); it != flows.end(); ++it) {
 			StationID from = it->first;
 			CargoDataEntry *source_entry = cargo_entry->InsertOrRetrieve(from);
-			const FlowStat::SharesMap *shares = it->second.GetShares();
-			for (FlowStat::SharesMap::const_iterator flow_it = shares->begin(); flow_it != shares->end(); ++flow_it) {
+			const FlowStat::SharesVector *shares = it->second.GetShares();
+			for (FlowStat::SharesVector::const_iterator flow_it = shares->begin(); flow_it != shares->end(); ++flow_it) {
 				StationID via = flow_it->second;
 				CargoDataEntry *via_entry = source_entry->InsertOrRetrieve(via);
 				if (via == this->window_number) {
@@ -1329,8 +1329,8 @@ struct StationViewWindow : public Window {
 			const FlowStatMap &flowmap = Station::Get(next)->goods[cargo].flows;
 			FlowStatMap::const_iterator map_it = flowmap.find(source);
 			if (map_it != flowmap.end()) {
-				const FlowStat::SharesMap *shares = map_it->second.GetShares();
-				for (FlowStat::SharesMap::const_iterator i = shares->begin(); i != shares->end(); ++i) {
+				const FlowStat::SharesVector *shares = map_it->second.GetShares();
+				for (FlowStat::SharesVector::const_iterator i = shares->begin(); i != shares->end(); ++i) {
 					tmp.InsertOrRetrieve(i->second)->Update(i->first);
 				}
 			}
@@ -1379,8 +1379,8 @@ struct StationViewWindow : public Window {
 		for (FlowStatMap::const_iterator it = flows.begin(); it != flows.end(); ++it) {
 			StationID from = it->first;
 			const CargoDataEntry *source_entry = source_dest->Retrieve(from);
-			const FlowStat::SharesMap *shares = it->second.GetShares();
-			for (FlowStat::SharesMap::const_iterator flow_it = shares->begin(); flow_it != shares->end(); ++flow_it) {
+			const FlowStat::SharesVector *shares = it->second.GetShares();
+			for (FlowStat::SharesVector::const_iterator flow_it = shares->begin(); flow_it != shares->end(); ++flow_it) {
 				const CargoDataEntry *via_entry = source_entry->Retrieve(flow_it->second);
 				for (CargoDataSet::iterator dest_it = via_entry->Begin(); dest_it != via_entry->End(); ++dest_it) {
 					CargoDataEntry *dest_entry = *dest_it;
@@ -1493,6 +1493,29 @@ struct StationViewWindow : public Window {
 		}
 	}
 
+	/**
+	 * Select the string for an entry of cargo from a station. If the link
+	 * graph has planned routes for it, the string tells how far the cargo
+	 * still has to go from here on average.
+	 * @param station Station the cargo comes from.
+	 * @param cargo Cargo of the entry.
+	 * @return Appropriate string.
+	 */
+	StringID GetSourceString(StationID station, CargoID cargo)
+	{
+		StringID str = this->GetEntryString(station, STR_STATION_VIEW_FROM_HERE, STR_STATION_VIEW_FROM, STR_STATION_VIEW_FROM_ANY);
+		if (str == STR_STATION_VIEW_FROM_ANY || cargo == CT_INVALID) return str;
+
+		uint distance = Station::Get(this->window_number)->goods[cargo].GetRouteDistance(station);
+		if (distance == 0) return str;
+		if (str == STR_STATION_VIEW_FROM_HERE) {
+			SetDParam(2, distance);
+			return STR_STATION_VIEW_FROM_HERE_DISTANCE;
+		}
+		SetDParam(3, distance);
+		return STR_STATION_VIEW_FROM_DISTANCE;
+	}
+
 	/**
 	 * Determine if we need to show the special "non-stop" string.
 	 * @param cd Entry we are going to show.
@@ -1565,7 +1588,7 @@ struct StationViewWindow : public Window {
 
 					switch (this->groupings[column]) {
 						case GR_SOURCE:
-							str = this->GetEntryString(station, STR_STATION_VIEW_FROM_HERE, STR_STATION_VIEW_FROM, STR_STATION_VIEW_FROM_ANY);
+							str = this->GetSourceString(station, cargo);
 							break;
 						case GR_NEXT:
 							str = this->GetEntryString(station, STR_STATION_VIEW_VIA_HERE, STR_STATION_VIEW_VIA, STR_STATION_VIEW_VIA_ANY);
@@ -86,6 +86,15 @@ enum CatchmentArea {
 	MAX_CATCHMENT      = 10, ///< Maximum catchment for airports with "modified catchment" enabled
 };
 
+/** Policies for choosing the cargo that is removed when too much is waiting at a station. */
+enum CargoTruncationPolicy {
+	CTP_BEGIN = 0,
+	CTP_PROPORTIONAL = 0, ///< Remove random cargo, so that every next hop loses about the same share of its cargo.
+	CTP_OLDEST,           ///< Remove the cargo with the most days in transit first.
+	CTP_FARTHEST,         ///< Remove the cargo that has travelled the farthest from its source first.
+	CTP_END,
+};
+
 static const uint MAX_LENGTH_STATION_NAME_CHARS = 32; ///< The maximum length of a station name in characters including '\0'
 
 /** List of station IDs */
@@ -19,6 +19,7 @@
 #include "object_base.h"
 #include "company_base.h"
 #include "company_func.h"
+#include "pathfinder/yapf/yapf_cache.h"
 
 #include "table/strings.h"
 
@@ -373,6 +374,7 @@ CommandCost CmdTerraformLand(TileIndex tile, DoCommandFlag flags, uint32 p1, uin
 			int count;
 			TileIndex *ti = ts.tile_table;
 			for (count = ts.tile_table_count; count != 0; count--, ti++) {
+				YapfNotifyRoadCostChange(*ti);
 				MarkTileDirtyByTile(*ti);
 			}
 		}
@@ -14,6 +14,7 @@
 #include "articulated_vehicles.h"
 #include "command_func.h"
 #include "pathfinder/npf/npf_func.h"
+#include "pathfinder/pf_stats.h"
 #include "pathfinder/yapf/yapf.hpp"
 #include "news_func.h"
 #include "company_func.h"
@@ -1938,6 +1939,7 @@ static FindDepotData FindClosestTrainDepot(Train *v, int max_distance)
 	PBSTileInfo origin = FollowTrainReservation(v);
 	if (IsRailDepotTile(origin.tile)) return FindDepotData(origin.tile, 0);
 
+	PathfinderCallTimer timer(v, _settings_game.pf.pathfinder_for_trains);
 	switch (_settings_game.pf.pathfinder_for_trains) {
 		case VPF_NPF: return NPFTrainFindNearestDepot(v, max_distance);
 		case VPF_YAPF: return YapfTrainFindNearestDepot(v, max_distance);
@@ -2213,6 +2215,7 @@ static const byte _initial_tile_subcoord[6][4][3] = {
  */
 static Track DoTrainPathfind(const Train *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks, bool &path_found, bool do_track_reservation, PBSTileInfo *dest)
 {
+	PathfinderCallTimer timer(v, _settings_game.pf.pathfinder_for_trains);
 	switch (_settings_game.pf.pathfinder_for_trains) {
 		case VPF_NPF: return NPFTrainChooseTrack(v, tile, enterdir, tracks, path_found, do_track_reservation, dest);
 		case VPF_YAPF: return YapfTrainChooseTrack(v, tile, enterdir, tracks, path_found, do_track_reservation, dest);
@@ -2320,6 +2323,7 @@ static PBSTileInfo ExtendTrainReservation(const Train *v, TrackBits *new_tracks,
  */
 static bool TryReserveSafeTrack(const Train *v, TileIndex tile, Trackdir td, bool override_tailtype)
 {
+	PathfinderCallTimer timer(v, _settings_game.pf.pathfinder_for_trains);
 	switch (_settings_game.pf.pathfinder_for_trains) {
 		case VPF_NPF: return NPFTrainFindNearestSafeTile(v, tile, td, override_tailtype);
 		case VPF_YAPF: return YapfTrainFindNearestSafeTile(v, tile, td, override_tailtype);
@@ -2642,6 +2646,7 @@ static bool CheckReverseTrain(const Train *v)
 
 	assert(v->track != TRACK_BIT_NONE);
 
+	PathfinderCallTimer timer(v, _settings_game.pf.pathfinder_for_trains);
 	switch (_settings_game.pf.pathfinder_for_trains) {
 		case VPF_NPF: return NPFTrainCheckReverse(v);
 		case VPF_YAPF: return YapfTrainCheckReverse(v);
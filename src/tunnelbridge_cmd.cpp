@@ -467,6 +467,8 @@ CommandCost CmdBuildBridge(TileIndex end_tile, DoCommandFlag flags, uint32 p1, u
 				}
 				MakeRoadBridgeRamp(tile_start, owner, bridge_type, dir,                 roadtypes);
 				MakeRoadBridgeRamp(tile_end,   owner, bridge_type, ReverseDiagDir(dir), roadtypes);
+				YapfNotifyRoadLayoutChange(tile_start);
+				YapfNotifyRoadLayoutChange(tile_end);
 				break;
 
 			case TRANSPORT_WATER:
@@ -491,6 +493,7 @@ CommandCost CmdBuildBridge(TileIndex end_tile, DoCommandFlag flags, uint32 p1, u
 		Track track = AxisToTrack(direction);
 		AddSideToSignalBuffer(tile_start, INVALID_DIAGDIR, company);
 		YapfNotifyTrackLayoutChange(tile_start, track);
+		YapfNotifyTrackLayoutChange(tile_end, track);
 	}
 
 	/* for human player that builds the bridge he gets a selection to choose from bridges (DC_QUERY_COST)
@@ -676,6 +679,7 @@ CommandCost CmdBuildTunnel(TileIndex start_tile, DoCommandFlag flags, uint32 p1,
 			MakeRailTunnel(end_tile,   company, ReverseDiagDir(direction), railtype);
 			AddSideToSignalBuffer(start_tile, INVALID_DIAGDIR, company);
 			YapfNotifyTrackLayoutChange(start_tile, DiagDirToDiagTrack(direction));
+			YapfNotifyTrackLayoutChange(end_tile,   DiagDirToDiagTrack(direction));
 		} else {
 			if (c != NULL) {
 				RoadType rt;
@@ -685,6 +689,8 @@ CommandCost CmdBuildTunnel(TileIndex start_tile, DoCommandFlag flags, uint32 p1,
 			}
 			MakeRoadTunnel(start_tile, company, direction,                 rts);
 			MakeRoadTunnel(end_tile,   company, ReverseDiagDir(direction), rts);
+			YapfNotifyRoadLayoutChange(start_tile);
+			YapfNotifyRoadLayoutChange(end_tile);
 		}
 		DirtyCompanyInfrastructureWindows(company);
 	}
@@ -816,6 +822,8 @@ static CommandCost DoClearTunnel(TileIndex tile, DoCommandFlag flags)
 
 			DoClearSquare(tile);
 			DoClearSquare(endtile);
+			YapfNotifyRoadLayoutChange(tile);
+			YapfNotifyRoadLayoutChange(endtile);
 		}
 	}
 	return CommandCost(EXPENSES_CONSTRUCTION, _price[PR_CLEAR_TUNNEL] * len);
@@ -885,6 +893,8 @@ static CommandCost DoClearBridge(TileIndex tile, DoCommandFlag flags)
 					DirtyCompanyInfrastructureWindows(c->index);
 				}
 			}
+			YapfNotifyRoadLayoutChange(tile);
+			YapfNotifyRoadLayoutChange(endtile);
 		} else { // Aqueduct
 			if (Company::IsValidID(owner)) Company::Get(owner)->infrastructure.water -= len * TUNNELBRIDGE_TRACKBIT_FACTOR;
 		}